@@ -102,6 +102,10 @@ SOURCE=..\..\src\osgHaptics\ForceEffect.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\ForceModelWorker.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\ForceOperator.cpp
 # End Source File
 # Begin Source File
@@ -138,10 +142,34 @@ SOURCE=..\..\src\osgHaptics\Material.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\MeshDecimator.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\osgHaptics.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\RenderForceFilter.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\osgHaptics\ServoLoop.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\osgHaptics\ServoReplay.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\osgHaptics\ServoStatistics.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\osgHaptics\ServoTrace.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\Shape.cpp
 # End Source File
 # Begin Source File
@@ -150,30 +178,58 @@ SOURCE=..\..\src\osgHaptics\ShapeComposite.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\SimulatedDevice.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\SpringForceOperator.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\SpringGroupForceOperator.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\TouchModel.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\TriangleCache.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\TriangleExtractor.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osgHaptics\TriangleInstances.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\osgHaptics\TriangleSet.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osgHaptics\Version.cpp
 # End Source File
 # Begin Source File
 
 SOURCE=..\..\src\osgHaptics\VibrationForceOperator.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\src\osgHaptics\VibrationGroupForceOperator.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
 # PROP Default_Filter "h;hpp;hxx;hm;inl;inc;xsd"
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\BoundingVolumeHierarchy.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\ContactEventHandler.h
 # End Source File
 # Begin Source File
@@ -194,6 +250,10 @@ SOURCE=..\..\include\osgHaptics\ForceEffect.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\ForceModelWorker.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\ForceOperator.h
 # End Source File
 # Begin Source File
@@ -230,10 +290,18 @@ SOURCE=..\..\include\osgHaptics\HashedGridDrawable.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\LocalForceModel.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\Material.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\MeshDecimator.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\MonoCullCallback.h
 # End Source File
 # Begin Source File
@@ -242,10 +310,42 @@ SOURCE=..\..\include\osgHaptics\osgHaptics.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\ParameterBuffer.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\RenderForceFilter.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\RenderTriangleOperator.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\ServoFrame.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\ServoInput.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\ServoLoop.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\ServoReplay.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\ServoStatistics.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\ServoTrace.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\Shape.h
 # End Source File
 # Begin Source File
@@ -254,18 +354,38 @@ SOURCE=..\..\include\osgHaptics\ShapeComposite.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\SimulatedDevice.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\SpringForceOperator.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\SpringGroupForceOperator.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\TouchModel.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\TriangleCache.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\TriangleExtractor.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\osgHaptics\TriangleInstances.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\TriangleSet.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\osgHaptics\types.h
 # End Source File
 # Begin Source File
@@ -280,6 +400,10 @@ SOURCE=..\..\include\osgHaptics\Version.h
 
 SOURCE=..\..\include\osgHaptics\VibrationForceOperator.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\include\osgHaptics\VibrationGroupForceOperator.h
+# End Source File
 # End Group
 # End Target
 # End Project
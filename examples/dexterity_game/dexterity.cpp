@@ -177,7 +177,7 @@ DexterityLineDrawable *createDexteritySpline(osg::Group *visual_root, osg::Group
 
     float outer_radius = 0.2;
     float inner_radius = 0.15;
-    osgHaptics::VibrationForceOperator *force_operator = new osgHaptics::VibrationForceOperator();
+    osgHaptics::VibrationForceOperator *force_operator = new osgHaptics::VibrationForceOperator(device);
     device->addForceOperator(force_operator);
 
     force_operator->setFrequency(50);
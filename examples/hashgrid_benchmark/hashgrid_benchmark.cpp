@@ -0,0 +1,181 @@
+/* -*-c++-*- OpenSceneGraph Haptics Library - * Copyright (C) 2006 VRlab, Ume University
+*
+* This application is open source and may be redistributed and/or modified   
+* freely and without restriction, both in commericial and non commericial applications,
+* as long as this copyright notice is maintained.
+* 
+* This application is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+/*!
+  Measures how many candidate triangles a HashedGrid proximity query returns as the mesh grows.
+
+  A sphere is tessellated into meshes of increasing size, each triangle is inserted at its three vertices
+  (as osgHapticsViewer does) and random points on the surface are queried. For each mesh the grid is built
+  both with a fixed resolution and with a resolution that keeps the number of triangles per cell constant.
+  The bulk column times build() with the bounding box of each triangle, the last column times query() with
+  a sphere of one cell radius, which returns each triangle once.
+
+  Usage: hashgrid_benchmark [--hash-size <n>] [--queries <n>] [--max-triangles <n>]
+*/
+
+
+#include <osgHaptics/HashedGrid.h>
+#include <osg/Timer>
+#include <osg/Math>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+typedef osgHaptics::HashedGrid<unsigned int> IndexGrid;
+
+struct Triangle {
+  osg::Vec3 v[3];
+};
+
+/// Tessellate a unit sphere into segments^2 triangles
+static void makeSphere(unsigned int segments, std::vector<Triangle>& triangles)
+{
+  triangles.clear();
+  unsigned int rings = segments/2;
+  for(unsigned int r=0; r < rings; r++) {
+    double t0 = osg::PI*r/rings, t1 = osg::PI*(r+1)/rings;
+    for(unsigned int s=0; s < segments; s++) {
+      double p0 = 2*osg::PI*s/segments, p1 = 2*osg::PI*(s+1)/segments;
+      osg::Vec3 a(sin(t0)*cos(p0), sin(t0)*sin(p0), cos(t0));
+      osg::Vec3 b(sin(t1)*cos(p0), sin(t1)*sin(p0), cos(t1));
+      osg::Vec3 c(sin(t1)*cos(p1), sin(t1)*sin(p1), cos(t1));
+      osg::Vec3 d(sin(t0)*cos(p1), sin(t0)*sin(p1), cos(t0));
+
+      Triangle tri;
+      tri.v[0] = a; tri.v[1] = b; tri.v[2] = c;
+      triangles.push_back(tri);
+
+      tri.v[0] = a; tri.v[1] = c; tri.v[2] = d;
+      triangles.push_back(tri);
+    }
+  }
+}
+
+static osg::Vec3 randomPointOnSphere()
+{
+  double z = 2.0*rand()/RAND_MAX-1.0;
+  double phi = 2*osg::PI*rand()/RAND_MAX;
+  double r = sqrt(1-z*z);
+  return osg::Vec3(r*cos(phi), r*sin(phi), z);
+}
+
+/// Build a grid with hash_size cells along each axis, query it and print one line of results
+static void run(const std::vector<Triangle>& triangles, unsigned int hash_size, unsigned int num_queries)
+{
+  osg::Timer *timer = osg::Timer::instance();
+
+  osg::ref_ptr<IndexGrid> grid = new IndexGrid(osg::Vec3(2,2,2), hash_size);
+  grid->setCenter(osg::Vec3(0,0,0));
+
+  osg::Timer_t start = timer->tick();
+  for(unsigned int i=0; i < triangles.size(); i++) {
+    for(unsigned int j=0; j < 3; j++)
+      grid->insert(triangles[i].v[j], i);
+  }
+  grid->finalize();
+  double build_time = timer->delta_s(start, timer->tick());
+
+  // Bulk build from the triangle bounding boxes, including gathering them
+  osg::ref_ptr<IndexGrid> bulk_grid = new IndexGrid(osg::Vec3(2,2,2), hash_size);
+  bulk_grid->setCenter(osg::Vec3(0,0,0));
+
+  start = timer->tick();
+  std::vector<osg::BoundingBox> bounds(triangles.size());
+  std::vector<unsigned int> indices(triangles.size());
+  for(unsigned int i=0; i < triangles.size(); i++) {
+    for(unsigned int j=0; j < 3; j++)
+      bounds[i].expandBy(triangles[i].v[j]);
+    indices[i] = i;
+  }
+  bulk_grid->build(bounds, indices);
+  double bulk_time = timer->delta_s(start, timer->tick());
+
+  // Stamp each triangle with the query number to count unique triangles
+  std::vector<unsigned int> seen(triangles.size(), 0);
+
+  osg::Vec3 cell_size = grid->getCellSize();
+  float radius = osg::maximum(cell_size[0], osg::maximum(cell_size[1], cell_size[2]));
+
+  double cells = 0, candidates = 0, unique = 0;
+  IndexGrid::HashVector result;
+  IndexGrid::QueryResult range_result;
+  srand(1);
+  double query_time = 0, range_time = 0;
+  for(unsigned int q=1; q <= num_queries; q++) {
+    osg::Vec3 p = randomPointOnSphere();
+
+    result.clear();
+    start = timer->tick();
+    grid->intersect(p, result);
+    query_time += timer->delta_u(start, timer->tick());
+
+    start = timer->tick();
+    grid->query(p, radius, range_result);
+    range_time += timer->delta_u(start, timer->tick());
+
+    cells += result.size();
+    for(unsigned int c=0; c < result.size(); c++) {
+      candidates += result[c].size();
+      for(IndexGrid::Cell::const_iterator it = result[c].begin(); it != result[c].end(); it++) {
+        if (seen[*it] != q) {
+          seen[*it] = q;
+          unique++;
+        }
+      }
+    }
+  }
+
+  std::cout << std::setw(10) << triangles.size() 
+    << std::setw(7) << grid->getHashSize()
+    << std::setw(10) << grid->getNumCells()
+    << std::setw(9) << std::setprecision(3) << build_time
+    << std::setw(9) << bulk_time
+    << std::setw(9) << cells/num_queries
+    << std::setw(12) << candidates/num_queries
+    << std::setw(12) << unique/num_queries
+    << std::setw(10) << query_time/num_queries
+    << std::setw(10) << range_time/num_queries << std::endl;
+}
+
+int main( int argc, char **argv )
+{
+  unsigned int fixed_hash_size = 100;
+  unsigned int num_queries = 10000;
+  unsigned int max_triangles = 2000000;
+  for(int i=1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--hash-size" && i+1 < argc)
+      fixed_hash_size = atoi(argv[++i]);
+    else if (arg == "--queries" && i+1 < argc)
+      num_queries = atoi(argv[++i]);
+    else if (arg == "--max-triangles" && i+1 < argc)
+      max_triangles = atoi(argv[++i]);
+  }
+
+  std::cout << " triangles  hash     cells  build s   bulk s    cells  candidates      unique  query us  range us" << std::endl;
+
+  std::vector<Triangle> triangles;
+  for(unsigned int segments=64; segments*segments <= max_triangles; segments *= 2) {
+    makeSphere(segments, triangles);
+
+    // Fixed resolution, the number of candidates grows with the mesh
+    run(triangles, fixed_hash_size, num_queries);
+
+    // Cells about the size of a triangle, the number of candidates stays constant
+    run(triangles, segments/2, num_queries);
+  }
+
+  return 0;
+}
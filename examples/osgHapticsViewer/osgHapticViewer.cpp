@@ -48,39 +48,14 @@
 
 #include  <osgHaptics/HashedGrid.h>
 #include  <osgHaptics/HashedGridDrawable.h>
-#include  <osgHaptics/TriangleExtractor.h>
+#include  <osgHaptics/TriangleCache.h>
+#include  <osgHaptics/TriangleInstances.h>
 
 #include <osg/ref_ptr>
 #include <time.h>
 #include <iostream>
 #include <osg/io_utils>
 
-class  HashGridTriangleExtractOperator : public osgHaptics::TriangleExtractOperator
-{
-
-public:
-
-  /// Constructor
-  HashGridTriangleExtractOperator(osgHaptics::HashedGridDrawable::TriangleHashGrid *grid) : m_hash_grid(grid) { }
-
-  /*!
-  This method is a pure virtual method that has to be inherited. 
-  This method will be called for each triangle. The vertices are given in
-  world coordinates using the accumulated matrix.
-  */
-  virtual void triangle(const osg::Vec3& v1,const osg::Vec3& v2,const osg::Vec3& v3)
-  {
-    osgHaptics::HashedGridDrawable::Triangle *triangle = new osgHaptics::HashedGridDrawable::Triangle(v1,v2,v3);
-    m_hash_grid->insert(v1, triangle);
-    m_hash_grid->insert(v2, triangle);
-    m_hash_grid->insert(v3, triangle);
-  }
-
-
-private:
-  osg::ref_ptr<osgHaptics::HashedGridDrawable::TriangleHashGrid> m_hash_grid;
-};
-
 
 
 
@@ -187,8 +162,12 @@ int main( int argc, char **argv )
   arguments.getApplicationUsage()->addCommandLineOption("--damping <float>","Set the damping in the friction equation (spring)");
   arguments.getApplicationUsage()->addCommandLineOption("--hash","Hash the loaded model for faster intersection test.");
   arguments.getApplicationUsage()->addCommandLineOption("--cell-size", "Number of cells in the hashspace in each dimension.");
+  arguments.getApplicationUsage()->addCommandLineOption("--cache <filename>", "Like --hash, but read the triangles and their hierarchy from a memory mapped cache file, written if missing or out of date");
   arguments.getApplicationUsage()->addCommandLineOption("--render-triangles", "Visually render the triangles that are haptically rendered");
-  arguments.getApplicationUsage()->addCommandLineOption("--remove-instances","Do a deep copy and remove any instances of the haptic scenegraph");
+  arguments.getApplicationUsage()->addCommandLineOption("--cull-radius <float>", "Only render the triangles within this distance of the proxy haptically");
+  arguments.getApplicationUsage()->addCommandLineOption("--haptic-lods <n>", "Build n simplified levels of each haptic geometry");
+  arguments.getApplicationUsage()->addCommandLineOption("--lod-distance <float>", "Render geometries further than this from the proxy with a simplified level, one level coarser per doubling");
+  arguments.getApplicationUsage()->addCommandLineOption("--remove-instances","Do a deep copy and remove any instances of the haptic scenegraph. Not needed with --hash, which shares instanced triangles");
   arguments.getApplicationUsage()->addCommandLineOption("--bbox-volume","Set the active haptic volume to the bbox of the haptic scene. Default is current ViewFrustum");
   arguments.getApplicationUsage()->addCommandLineOption("--workspace-scale <float>","Scale the haptic workspace.");
 
@@ -237,6 +216,9 @@ int main( int argc, char **argv )
 
   bool use_hash = arguments.read("--hash");
 
+  std::string cache_file;
+  bool use_cache = arguments.read("--cache", cache_file);
+
   bool bbox_volume = false;
   bbox_volume = arguments.read("--bbox-volume");
 
@@ -269,6 +251,16 @@ int main( int argc, char **argv )
 
   bool remove_instances = arguments.read("--remove-instances");
 
+  // See if haptic culling around the proxy is specified
+  float cull_radius=0;
+  arguments.read("--cull-radius", cull_radius);
+
+  // See if haptic levels of detail are specified
+  unsigned int haptic_lods=1;
+  arguments.read("--haptic-lods", haptic_lods);
+  float lod_distance=0;
+  arguments.read("--lod-distance", lod_distance);
+
   // report any errors if they have occured when parsing the program arguments.
   if (arguments.errors())
   {
@@ -318,6 +310,8 @@ int main( int argc, char **argv )
 		haptic_device->createContext();			
     haptic_device->makeCurrent(); // Make this device the current one
     haptic_device->setEnableForceOutput(true); // Render output forces
+    haptic_device->setCullRadius(cull_radius);
+    haptic_device->setLODDistance(lod_distance);
 
 
     // Root of the haptic scene
@@ -341,7 +335,8 @@ int main( int argc, char **argv )
     // It merely attaches a osgHaptics::Shape ontop of each Drawable.
     // 
 
-    if (remove_instances) {
+    // The hashed grid refers to the triangles of each instance, so only the haptic shapes need the deep copy
+    if (remove_instances && !use_hash && !use_cache) {
       std::cerr << "Removing instances" << std::endl;
       osg::Object *clone = loadedModel->clone(osg::CopyOp(osg::CopyOp::DEEP_COPY_ALL));
       osg::ref_ptr<osg::Node> node = dynamic_cast<osg::Node *>(clone);
@@ -351,7 +346,26 @@ int main( int argc, char **argv )
     osg::Node *visual_node = loadedModel.get();
     osg::Node *haptic_node = loadedModel.get();
   
-    if (use_hash)
+    if (use_cache)
+    {
+      osg::Timer_t start = osg::Timer::instance()->tick();
+
+      // The triangles and their hierarchy are mapped from the file if it was written for this model
+      osg::ref_ptr<osgHaptics::TriangleCache> cache = new osgHaptics::TriangleCache;
+      bool cached = cache->load(cache_file, *loadedModel);
+
+      osg::Timer_t stop = osg::Timer::instance()->tick();
+      std::cerr << (cached ? "Mapped " : "Wrote ") << cache_file << " with " << cache->getNumTriangles() << " triangles"
+        << "  t: " << osg::Timer::instance()->delta_s(start,stop) << std::endl;
+
+      osg::ref_ptr<osgHaptics::HashedGridDrawable> grid_drawable = new osgHaptics::HashedGridDrawable(0L, haptic_device.get());
+      grid_drawable->setTriangleCache(cache.get());
+
+      osg::Geode *geode = new osg::Geode;
+      geode->addDrawable(grid_drawable.get());
+      haptic_node = geode;
+    }
+    else if (use_hash)
     {
       std::cerr << "Will hash model " << std::endl;
       using namespace osgHaptics;
@@ -365,19 +379,26 @@ int main( int argc, char **argv )
 
       dim = bbox._max - bbox._min;
       osg::Vec3 center = bbox.center();
-      osg::ref_ptr<osgHaptics::HashedGridDrawable::TriangleHashGrid> grid = new osgHaptics::HashedGridDrawable::TriangleHashGrid(dim, cell_size);
+      osg::ref_ptr<osgHaptics::HashedGridDrawable::InstanceHashGrid> grid = new osgHaptics::HashedGridDrawable::InstanceHashGrid(dim, cell_size);
       grid->setCenter(center);
 
-      HashGridTriangleExtractOperator hteo(grid.get());
-    
-      TriangleExtractor te(hteo);
-
       osg::Timer_t start = osg::Timer::instance()->tick();
-      loadedModel->accept(te);
+
+      // Each unique geometry is triangulated once, the grid stores references to the triangles of each instance
+      osg::ref_ptr<osgHaptics::TriangleInstances> instances = new osgHaptics::TriangleInstances;
+      instances->extract(*loadedModel);
+
+      std::vector<osg::BoundingBox> bounds;
+      std::vector<osgHaptics::TriangleInstances::TriangleRef> refs;
+      instances->getTriangleBounds(bounds, refs);
+      grid->build(bounds, refs);
+
       osg::Timer_t stop = osg::Timer::instance()->tick();
       std::cerr << "Time to hash " << "  t: " << osg::Timer::instance()->delta_s(start,stop) << std::endl;
+      std::cerr << instances->getTriangleSets().size() << " unique geometries in " << instances->getInstances().size() 
+        << " instances" << std::endl;
       
-      osg::ref_ptr<osgHaptics::HashedGridDrawable> grid_drawable = new osgHaptics::HashedGridDrawable(grid.get(), haptic_device.get());
+      osg::ref_ptr<osgHaptics::HashedGridDrawable> grid_drawable = new osgHaptics::HashedGridDrawable(grid.get(), instances.get(), haptic_device.get());
 
       osg::Geode *geode = new osg::Geode;
       geode->addDrawable(grid_drawable.get());
@@ -402,6 +423,7 @@ int main( int argc, char **argv )
     // If several nodes are to be prepared, make sure to call the HapticRenderPrepareVisitor::reset() method
     // inbetween
     osgHaptics::HapticRenderPrepareVisitor vis(haptic_device.get());
+    vis.setNumLODs(haptic_lods);
     haptic_node->accept(vis);
     
     // Return the compound shape (can be used for contact tests, disabling haptic rendering for this subgraph etc.
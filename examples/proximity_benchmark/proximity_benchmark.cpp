@@ -0,0 +1,224 @@
+/* -*-c++-*- OpenSceneGraph Haptics Library - * Copyright (C) 2006 VRlab, Ume University
+*
+* This application is open source and may be redistributed and/or modified   
+* freely and without restriction, both in commericial and non commericial applications,
+* as long as this copyright notice is maintained.
+* 
+* This application is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+/*!
+  Compares the proximity queries of HashedGrid and BoundingVolumeHierarchy on the same triangles.
+
+  The triangles are extracted from the given models with ParallelTriangleExtractor. Without models a scene with a mix of
+  scales is generated: a large floor made of two triangles with small, finely tessellated spheres ("screws")
+  scattered over it. Both structures are built from the triangle bounding boxes and queried with a sphere
+  around random points on the triangles, like HashedGridDrawable does around the proxy.
+
+  Usage: proximity_benchmark [--hash-size <n>] [--queries <n>] [--radius <r>] [--screws <n>] [--threads <n>] [model files]
+*/
+
+
+#include <osgHaptics/HashedGrid.h>
+#include <osgHaptics/BoundingVolumeHierarchy.h>
+#include <osgHaptics/TriangleExtractor.h>
+#include <osgDB/ReadFile>
+#include <osg/Timer>
+#include <osg/Math>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+typedef osgHaptics::HashedGrid<unsigned int> IndexGrid;
+typedef osgHaptics::BoundingVolumeHierarchy<unsigned int> IndexHierarchy;
+
+struct Triangle {
+  osg::Vec3 v[3];
+};
+
+static double random(double min, double max)
+{
+  return min + (max-min)*rand()/RAND_MAX;
+}
+
+/// Add a sphere with segments^2 triangles
+static void addSphere(const osg::Vec3& center, float radius, unsigned int segments, std::vector<Triangle>& triangles)
+{
+  unsigned int rings = segments/2;
+  for(unsigned int r=0; r < rings; r++) {
+    double t0 = osg::PI*r/rings, t1 = osg::PI*(r+1)/rings;
+    for(unsigned int s=0; s < segments; s++) {
+      double p0 = 2*osg::PI*s/segments, p1 = 2*osg::PI*(s+1)/segments;
+      osg::Vec3 a = center + osg::Vec3(sin(t0)*cos(p0), sin(t0)*sin(p0), cos(t0))*radius;
+      osg::Vec3 b = center + osg::Vec3(sin(t1)*cos(p0), sin(t1)*sin(p0), cos(t1))*radius;
+      osg::Vec3 c = center + osg::Vec3(sin(t1)*cos(p1), sin(t1)*sin(p1), cos(t1))*radius;
+      osg::Vec3 d = center + osg::Vec3(sin(t0)*cos(p1), sin(t0)*sin(p1), cos(t0))*radius;
+
+      Triangle tri;
+      tri.v[0] = a; tri.v[1] = b; tri.v[2] = c;
+      triangles.push_back(tri);
+
+      tri.v[0] = a; tri.v[1] = c; tri.v[2] = d;
+      triangles.push_back(tri);
+    }
+  }
+}
+
+/// A 20x20 floor with num_screws spheres of radius 0.01 on it
+static void makeScene(unsigned int num_screws, std::vector<Triangle>& triangles)
+{
+  Triangle floor;
+  floor.v[0].set(-10,-10,0); floor.v[1].set(10,-10,0); floor.v[2].set(10,10,0);
+  triangles.push_back(floor);
+  floor.v[1].set(10,10,0); floor.v[2].set(-10,10,0);
+  triangles.push_back(floor);
+
+  srand(2);
+  for(unsigned int i=0; i < num_screws; i++)
+    addSphere(osg::Vec3(random(-9,9), random(-9,9), 0.01), 0.01f, 32, triangles);
+}
+
+/// Random points on random triangles, where a proxy touching the model would be
+static void makeQueries(const std::vector<Triangle>& triangles, unsigned int num_queries, std::vector<osg::Vec3>& points)
+{
+  srand(1);
+  for(unsigned int q=0; q < num_queries; q++) {
+    const Triangle& t = triangles[rand() % triangles.size()];
+    double a = random(0,1), b = random(0,1);
+    if (a+b > 1) {
+      a = 1-a;
+      b = 1-b;
+    }
+    points.push_back(t.v[0] + (t.v[1]-t.v[0])*a + (t.v[2]-t.v[0])*b);
+  }
+}
+
+static void printResult(const std::string& name, double build_time, unsigned int memory, 
+  double found, double query_time, unsigned int num_queries)
+{
+  std::cout << std::setw(16) << name
+    << std::setw(10) << std::setprecision(3) << build_time
+    << std::setw(10) << memory/(1024.0*1024.0)
+    << std::setw(10) << found/num_queries
+    << std::setw(10) << query_time/num_queries << std::endl;
+}
+
+/// Build index from the triangle bounds, query it and print one line of results
+template <class Index>
+static void run(const std::string& name, Index *index, const std::vector<osg::BoundingBox>& bounds, 
+  const std::vector<unsigned int>& items, const std::vector<osg::Vec3>& points, float radius)
+{
+  osg::Timer *timer = osg::Timer::instance();
+
+  osg::Timer_t start = timer->tick();
+  index->build(bounds, items);
+  double build_time = timer->delta_s(start, timer->tick());
+
+  typename Index::QueryResult result;
+  double found = 0;
+  start = timer->tick();
+  for(unsigned int q=0; q < points.size(); q++)
+    found += index->query(points[q], radius, result);
+  double query_time = timer->delta_u(start, timer->tick());
+
+  printResult(name, build_time, index->getMemoryUsage(), found, query_time, points.size());
+}
+
+int main( int argc, char **argv )
+{
+  unsigned int hash_size = 0;
+  unsigned int num_queries = 10000;
+  unsigned int num_screws = 500;
+  unsigned int num_threads = 0;
+  float radius = 0.005f;
+  std::vector<std::string> files;
+  for(int i=1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--hash-size" && i+1 < argc)
+      hash_size = atoi(argv[++i]);
+    else if (arg == "--queries" && i+1 < argc)
+      num_queries = atoi(argv[++i]);
+    else if (arg == "--radius" && i+1 < argc)
+      radius = atof(argv[++i]);
+    else if (arg == "--screws" && i+1 < argc)
+      num_screws = atoi(argv[++i]);
+    else if (arg == "--threads" && i+1 < argc)
+      num_threads = atoi(argv[++i]);
+    else
+      files.push_back(arg);
+  }
+
+  std::vector<Triangle> triangles;
+  if (files.empty())
+    makeScene(num_screws, triangles);
+  else {
+    osg::ref_ptr<osg::Node> model = osgDB::readNodeFiles(files);
+    if (!model.valid()) {
+      std::cerr << argv[0] << ": Unable to load " << files[0] << std::endl;
+      return 1;
+    }
+
+    std::vector<osg::Vec3> vertices;
+    osgHaptics::ParallelTriangleExtractor extractor(num_threads);
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    extractor.extract(*model, vertices);
+    std::cout << "Extracted in " << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << " s" << std::endl;
+
+    triangles.resize(vertices.size()/3);
+    for(unsigned int i=0; i < triangles.size(); i++) {
+      for(unsigned int j=0; j < 3; j++)
+        triangles[i].v[j] = vertices[3*i+j];
+    }
+  }
+
+  if (triangles.empty()) {
+    std::cerr << argv[0] << ": No triangles" << std::endl;
+    return 1;
+  }
+
+  std::vector<osg::BoundingBox> bounds(triangles.size());
+  std::vector<unsigned int> items(triangles.size());
+  osg::BoundingBox scene_bound;
+  for(unsigned int i=0; i < triangles.size(); i++) {
+    for(unsigned int j=0; j < 3; j++)
+      bounds[i].expandBy(triangles[i].v[j]);
+    items[i] = i;
+    scene_bound.expandBy(bounds[i]);
+  }
+
+  std::vector<osg::Vec3> points;
+  makeQueries(triangles, num_queries, points);
+
+  std::cout << triangles.size() << " triangles, query radius " << radius << std::endl;
+  std::cout << "           index   build s  memory MB     found  query us" << std::endl;
+
+  std::vector<unsigned int> hash_sizes;
+  if (hash_size)
+    hash_sizes.push_back(hash_size);
+  else {
+    hash_sizes.push_back(32);
+    hash_sizes.push_back(128);
+    hash_sizes.push_back(512);
+  }
+
+  for(unsigned int h=0; h < hash_sizes.size(); h++) {
+    osg::ref_ptr<IndexGrid> grid = new IndexGrid(scene_bound._max-scene_bound._min, hash_sizes[h]);
+    grid->setCenter(scene_bound.center());
+
+    std::ostringstream name;
+    name << "grid " << hash_sizes[h];
+    run(name.str(), grid.get(), bounds, items, points, radius);
+  }
+
+  osg::ref_ptr<IndexHierarchy> hierarchy = new IndexHierarchy;
+  run("hierarchy", hierarchy.get(), bounds, items, points, radius);
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+/* -*-c++-*- OpenSceneGraph Haptics Library - * Copyright (C) 2006 VRlab, Ume University
+*
+* This application is open source and may be redistributed and/or modified   
+* freely and without restriction, both in commericial and non commericial applications,
+* as long as this copyright notice is maintained.
+* 
+* This application is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+/*!
+  Replays a servo trace written by HapticDevice::startTrace() through a set of ForceOperators, without a haptic device,
+  and prints the throughput and timing of the servo loop.
+
+  Usage: servo_replay <trace file> [--springs <n>] [--group] [--repeat <n>]
+
+  --group evaluates the springs with one SpringGroupForceOperator instead of one SpringForceOperator each.
+*/
+
+
+#include <osgHaptics/ServoReplay.h>
+#include <osgHaptics/SpringForceOperator.h>
+#include <osgHaptics/SpringGroupForceOperator.h>
+
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+
+int main( int argc, char **argv )
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <trace file> [--springs <n>] [--group] [--repeat <n>]" << std::endl;
+    return 1;
+  }
+
+  unsigned int num_springs = 1;
+  unsigned int repetitions = 1;
+  bool group = false;
+  for(int i=2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--springs" && i+1 < argc)
+      num_springs = atoi(argv[++i]);
+    else if (arg == "--repeat" && i+1 < argc)
+      repetitions = atoi(argv[++i]);
+    else if (arg == "--group")
+      group = true;
+  }
+
+  osg::ref_ptr<osgHaptics::ServoLoop> loop = new osgHaptics::ServoLoop;
+  osgHaptics::ServoReplay replay(loop.get());
+  if (!replay.open(argv[1]))
+    return 1;
+
+  if (group) {
+    osg::ref_ptr<osgHaptics::SpringGroupForceOperator> springs = new osgHaptics::SpringGroupForceOperator;
+    for(unsigned int i=0; i < num_springs; i++)
+      springs->addSpring(osg::Vec3d(0,0,0), 0.1);
+    loop->addForceOperator(springs.get());
+  }
+  else {
+    for(unsigned int i=0; i < num_springs; i++) {
+      osg::ref_ptr<osgHaptics::SpringForceOperator> spring = new osgHaptics::SpringForceOperator;
+      spring->setPosition(osg::Vec3d(0,0,0), 0);
+      spring->setStiffness(0.1);
+      loop->addForceOperator(spring.get());
+    }
+  }
+
+  double elapsed = replay.run(repetitions);
+  unsigned int ticks = replay.getNumTicks()*repetitions;
+
+  std::cerr << ticks << " ticks replayed in " << elapsed << "s (" << ticks/elapsed << " ticks/s)" << std::endl;
+  std::cerr << "Largest deviation from the recorded force: " << replay.getMaxForceDeviation() << std::endl;
+  loop->printServoStatistics(std::cerr);
+
+  return 0;
+}
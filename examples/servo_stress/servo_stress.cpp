@@ -0,0 +1,123 @@
+/* -*-c++-*- OpenSceneGraph Haptics Library - * Copyright (C) 2006 VRlab, Ume University
+*
+* This application is open source and may be redistributed and/or modified
+* freely and without restriction, both in commericial and non commericial applications,
+* as long as this copyright notice is maintained.
+*
+* This application is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+/*!
+  Adds and removes ForceOperators from the application thread as fast as possible while a simulated
+  device runs the servo loop at 1 kHz, and prints the worst case timing of the servo loop.
+
+  Usage: servo_stress [--seconds <n>] [--operators <n>] [--max-period <us>]
+
+  Each iteration adds --operators springs and vibrations and removes them again. The exit code is 1 if the
+  servo loop never evaluated an operator, or with --max-period, if any tick started more than that many
+  microseconds after the previous one.
+*/
+
+
+#include <osgHaptics/HapticDevice.h>
+#include <osgHaptics/SpringForceOperator.h>
+#include <osgHaptics/VibrationForceOperator.h>
+
+#include <osg/Timer>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+int main( int argc, char **argv )
+{
+  double seconds = 10;
+  unsigned int num_operators = 8;
+  double max_period = 0;
+  for(int i=1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--seconds" && i+1 < argc)
+      seconds = atof(argv[++i]);
+    else if (arg == "--operators" && i+1 < argc)
+      num_operators = atoi(argv[++i]);
+    else if (arg == "--max-period" && i+1 < argc)
+      max_period = atof(argv[++i]);
+    else {
+      std::cerr << "Usage: " << argv[0] << " [--seconds <n>] [--operators <n>] [--max-period <us>]" << std::endl;
+      return 1;
+    }
+  }
+
+  osg::ref_ptr<osgHaptics::HapticDevice> device = new osgHaptics::HapticDevice(osgHaptics::HapticDevice::SIMULATED_DEVICE);
+  device->getSimulatedDevice()->setUpdateRate(1000);
+
+  // Keep the end effector moving so the operators produce changing forces
+  device->getSimulatedDevice()->setTrajectory(new osgHaptics::SimulatedDevice::CircleTrajectory(
+    osg::Vec3d(0,0,0), osg::Vec3d(20,0,0), osg::Vec3d(0,20,0), 0.5));
+
+  device->createContext();
+
+  // The servo loop only evaluates the operators once it has a world to workspace matrix
+  device->setWorldToWorkSpaceMatrix(osg::Matrix::identity());
+
+  std::vector< osg::ref_ptr<osgHaptics::ForceOperator> > operators;
+  for(unsigned int i=0; i < num_operators; i++) {
+    osgHaptics::SpringForceOperator *spring = new osgHaptics::SpringForceOperator;
+    spring->setPosition(osg::Vec3d(0,0,0), 0);
+    spring->setStiffness(0.01);
+    operators.push_back(spring);
+
+    osgHaptics::VibrationForceOperator *vibration = new osgHaptics::VibrationForceOperator(device.get());
+    vibration->setFrequency(50+i);
+    vibration->setAmplitude(0.1);
+    operators.push_back(vibration);
+  }
+
+  // Skip the ticks from the startup of the scheduler
+  device->resetServoStatistics();
+
+  const osg::Timer *timer = osg::Timer::instance();
+  osg::Timer_t start = timer->tick();
+  unsigned int iterations = 0;
+  while (timer->delta_s(start, timer->tick()) < seconds) {
+    for(unsigned int i=0; i < operators.size(); i++)
+      device->addForceOperator(operators[i].get());
+    for(unsigned int i=0; i < operators.size(); i++)
+      device->removeForceOperator(operators[i].get());
+    iterations++;
+  }
+  double elapsed = timer->delta_s(start, timer->tick());
+
+  // Number of times the servo loop evaluated an operator from a snapshot that was being replaced
+  unsigned int evaluations = 0;
+  for(unsigned int i=0; i < operators.size(); i++)
+    evaluations += operators[i]->getCostHistogram().getCount();
+
+  const osgHaptics::ServoStatistics& statistics = device->getServoStatistics();
+  double worst_period = statistics.getTickPeriod().getMax();
+
+  std::cerr << iterations << " add/remove iterations of " << operators.size() << " operators in " << elapsed
+    << "s (" << iterations/elapsed << " iterations/s)" << std::endl;
+  std::cerr << "Operators evaluated by the servo loop: " << evaluations << " times" << std::endl;
+  std::cerr << "Worst case tick duration: " << statistics.getTickDuration().getMax() << "us" << std::endl;
+  std::cerr << "Worst case tick period: " << worst_period << "us (nominal 1000us)" << std::endl;
+  statistics.print(std::cerr);
+
+  device->shutdown(0);
+
+  if (!evaluations) {
+    std::cerr << "The servo loop never evaluated an operator" << std::endl;
+    return 1;
+  }
+
+  if (max_period > 0 && worst_period > max_period) {
+    std::cerr << "Worst case tick period exceeds " << max_period << "us" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
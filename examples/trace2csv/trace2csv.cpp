@@ -0,0 +1,70 @@
+/* -*-c++-*- OpenSceneGraph Haptics Library - * Copyright (C) 2006 VRlab, Ume University
+*
+* This application is open source and may be redistributed and/or modified   
+* freely and without restriction, both in commericial and non commericial applications,
+* as long as this copyright notice is maintained.
+* 
+* This application is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+/*!
+  Converts a binary servo trace written by HapticDevice::startTrace() into comma separated values.
+
+  Usage: trace2csv <trace file> [<csv file>]
+  If no csv file is given, the values are written to stdout.
+*/
+
+
+#include <osgHaptics/ServoTrace.h>
+
+#include <iostream>
+#include <fstream>
+
+
+int main( int argc, char **argv )
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <trace file> [<csv file>]" << std::endl;
+    return 1;
+  }
+
+  osgHaptics::ServoTraceReader reader;
+  if (!reader.open(argv[1]))
+    return 1;
+
+  std::ofstream file;
+  if (argc > 2) {
+    file.open(argv[2]);
+    if (!file.is_open()) {
+      std::cerr << "Unable to open " << argv[2] << " for writing" << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& os = (argc > 2) ? file : std::cout;
+
+  osgHaptics::ServoTraceReader::writeCSVHeader(os);
+
+  osgHaptics::TraceRecord record;
+  unsigned int n=0, dropped=0;
+  bool first = true;
+  unsigned int previous_tick=0;
+  while(reader.read(record)) {
+    // A gap in the tick counter means the writer thread could not keep up
+    if (!first && record.tick != previous_tick+1)
+      dropped += record.tick - previous_tick - 1;
+    first = false;
+    previous_tick = record.tick;
+
+    osgHaptics::ServoTraceReader::writeCSV(os, record);
+    n++;
+  }
+
+  std::cerr << n << " records converted";
+  if (dropped)
+    std::cerr << ", " << dropped << " records were dropped while tracing";
+  std::cerr << std::endl;
+
+  return 0;
+}
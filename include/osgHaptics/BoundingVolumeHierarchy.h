@@ -0,0 +1,468 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_BoundingVolumeHierarchy_h__
+#define __osgHaptics_BoundingVolumeHierarchy_h__
+
+#include <osg/Referenced>
+#include <osg/BoundingBox>
+#include <osg/Vec3>
+#include <osg/Matrix>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+
+namespace osgHaptics {
+
+/*!
+  Return an upper bound of how much m stretches distances: the Frobenius norm of its upper 3x3 block.
+  Multiply a query radius with it to query in the coordinates m transforms to. Unlike the largest of
+  getScale(), which are column norms, it holds for any combination of rotation and non uniform scale.
+*/
+inline float getMaxStretch(const osg::Matrix& m)
+{
+  double sum = 0;
+  for(unsigned int i=0; i < 3; i++)
+    for(unsigned int j=0; j < 3; j++)
+      sum += m(i,j)*m(i,j);
+  return (float)sqrt(sum);
+}
+
+
+/// A tree of axis aligned bounding boxes for proximity queries, an alternative to HashedGrid.
+
+/*!
+  A uniform grid needs one cell size for the whole scene. Tiny details then share a cell with thousands of
+  other items, or large items are registered in thousands of cells. The hierarchy adapts to the items instead:
+  build() splits them recursively where the surface area heuristic (SAH) predicts the cheapest queries.
+
+  The nodes are stored depth first in one flat array. The left child of an inner node directly follows it,
+  so a query walks the array mostly forward. Each item is stored once, so query() needs no deduplication.
+
+  For animated items, setBound() changes the bounding box of an item and refit() recomputes the node boxes
+  bottom up without changing the tree. The tree gets looser as the items move away from where it was built,
+  call build() again when query times grow.
+
+  The arrays of a built hierarchy can be written to a file as they are, see TriangleCache. setExternalData() 
+  then lets the hierarchy query such arrays in place, for example in a memory mapped file.
+*/
+template <class T>
+class BoundingVolumeHierarchy : public osg::Referenced
+{
+public:
+
+  /// Identifies an item, the items passed to build() get the handles 0..n-1
+  typedef unsigned int ItemHandle;
+
+  /// Items found by query(). Reuse one instance across queries, it keeps its memory.
+  class QueryResult {
+  public:
+    typedef typename std::vector<const T *>::const_iterator const_iterator;
+
+    /// The items point into the hierarchy and are invalidated by build() and clear()
+    const_iterator begin() const { return m_items.begin(); }
+    const_iterator end() const { return m_items.end(); }
+    unsigned int size() const { return m_items.size(); }
+    bool empty() const { return m_items.empty(); }
+    const T& operator[](unsigned int i) const { return *m_items[i]; }
+
+  private:
+    friend class BoundingVolumeHierarchy<T>;
+
+    std::vector<const T *> m_items;
+  };
+
+  enum { 
+    /// Largest number of items in a leaf
+    MAX_LEAF_SIZE = 4, 
+
+    /// Nodes at this depth become leaves whatever their size, this bounds the traversal stack
+    MAX_DEPTH = 64, 
+
+    /// Number of candidate split planes per axis evaluated by the SAH
+    NUM_BINS = 16 
+  };
+
+  /// A node of the tree
+  struct Node {
+    Node() : offset(0), count(0) {}
+
+    osg::BoundingBox bound;
+
+    /// The first item of a leaf, or the right child of an inner node
+    unsigned int offset;
+
+    /// Number of items in a leaf, 0 for inner nodes
+    unsigned int count;
+  };
+
+  BoundingVolumeHierarchy() { useOwnData(); }
+
+  /*!
+    Build the hierarchy from items, replacing the previous content.
+    \param bounds - The bounding box of each item
+    \param items - The items, items[i] is bounded by bounds[i]
+  */
+  void build(const std::vector<osg::BoundingBox>& bounds, const std::vector<T>& items);
+
+  /*!
+    Query arrays owned by someone else instead, as returned by getNodeData() and friends of a built hierarchy.
+    The arrays must stay valid until the next build(), clear() or setExternalData(). The hierarchy is then read only, 
+    setBound() and refit() must not be called.
+  */
+  void setExternalData(const Node *nodes, unsigned int num_nodes, const T *items, const osg::BoundingBox *item_bounds, 
+    const unsigned int *leaf_index, unsigned int num_items)
+  {
+    clear();
+    m_node_data = nodes;
+    m_num_nodes = num_nodes;
+    m_item_data = items;
+    m_item_bound_data = item_bounds;
+    m_leaf_index_data = leaf_index;
+    m_num_items = num_items;
+  }
+
+  /// Set the bounding box of item, the nodes are not updated until refit()
+  void setBound(ItemHandle item, const osg::BoundingBox& bound) { m_item_bounds[m_leaf_index[item]] = bound; }
+
+  /// Recompute the bounding boxes of all nodes from the items
+  void refit();
+
+  /*!
+    Get all items whose bounding box overlaps box.
+    \param box - The region to search
+    \param result - Cleared and filled with the items found
+    \returns the number of items found
+  */
+  unsigned int query(const osg::BoundingBox& box, QueryResult& result) const
+  {
+    return queryNodes(box, 0L, 0, result);
+  }
+
+  /// Get all items whose bounding box overlaps the sphere with center and radius
+  unsigned int query(const osg::Vec3& center, float radius, QueryResult& result) const
+  {
+    osg::Vec3 r(radius, radius, radius);
+    return queryNodes(osg::BoundingBox(center-r, center+r), &center, radius, result);
+  }
+
+  /// Return the item with handle
+  const T& getItem(ItemHandle item) const { return m_item_data[m_leaf_index_data[item]]; }
+
+  /// Return the bounding box of all items
+  osg::BoundingBox getBound() const { return m_num_nodes ? m_node_data[0].bound : osg::BoundingBox(); }
+
+  unsigned int getNumItems() const { return m_num_items; }
+  unsigned int getNumNodes() const { return m_num_nodes; }
+
+  /// The nodes depth first, getNumNodes() of them
+  const Node *getNodeData() const { return m_node_data; }
+
+  /// The items and their bounding boxes in leaf order, getNumItems() of each
+  const T *getItemData() const { return m_item_data; }
+  const osg::BoundingBox *getItemBoundData() const { return m_item_bound_data; }
+
+  /// For each handle, the index of its item in getItemData()
+  const unsigned int *getLeafIndexData() const { return m_leaf_index_data; }
+
+  /// Return the approximate number of bytes used by the hierarchy
+  unsigned int getMemoryUsage() const
+  {
+    return m_nodes.capacity()*sizeof(Node) + m_items.capacity()*sizeof(T) +
+      m_item_bounds.capacity()*sizeof(osg::BoundingBox) + m_leaf_index.capacity()*sizeof(unsigned int);
+  }
+
+  void clear()
+  {
+    m_nodes.clear();
+    m_items.clear();
+    m_item_bounds.clear();
+    m_leaf_index.clear();
+    useOwnData();
+  }
+
+private:
+
+  /// Point the data pointers at the vectors of this hierarchy
+  void useOwnData()
+  {
+    m_node_data = m_nodes.empty() ? 0L : &m_nodes.front();
+    m_num_nodes = m_nodes.size();
+    m_item_data = m_items.empty() ? 0L : &m_items.front();
+    m_item_bound_data = m_item_bounds.empty() ? 0L : &m_item_bounds.front();
+    m_leaf_index_data = m_leaf_index.empty() ? 0L : &m_leaf_index.front();
+    m_num_items = m_items.size();
+  }
+
+  /// Put the handles order[begin,end) under a new node and return its index
+  unsigned int buildNode(unsigned int begin, unsigned int end, unsigned int depth, 
+    std::vector<ItemHandle>& order, const std::vector<osg::BoundingBox>& bounds, const std::vector<osg::Vec3>& centroids);
+
+  /// Return the first handle of the right child when splitting order[begin,end), end if no split is possible
+  unsigned int split(unsigned int begin, unsigned int end, const osg::BoundingBox& centroid_bound,
+    std::vector<ItemHandle>& order, const std::vector<osg::BoundingBox>& bounds, const std::vector<osg::Vec3>& centroids);
+
+  unsigned int queryNodes(const osg::BoundingBox& box, const osg::Vec3 *center, float radius, QueryResult& result) const;
+
+  /// Return true if bound overlaps box and, if center is set, the sphere with center and radius
+  static bool overlaps(const osg::BoundingBox& bound, const osg::BoundingBox& box, const osg::Vec3 *center, float radius)
+  {
+    if (!bound.valid() || !bound.intersects(box))
+      return false;
+    if (!center)
+      return true;
+
+    float d2 = 0;
+    for(unsigned int a=0; a < 3; a++) {
+      float d = (*center)[a] < bound._min[a] ? bound._min[a]-(*center)[a] : 
+        ((*center)[a] > bound._max[a] ? (*center)[a]-bound._max[a] : 0);
+      d2 += d*d;
+    }
+    return d2 <= radius*radius;
+  }
+
+  /// Half the surface area of box, proportional to the probability that a random query hits it
+  static float area(const osg::BoundingBox& box)
+  {
+    if (!box.valid())
+      return 0;
+    osg::Vec3 d = box._max-box._min;
+    return d[0]*d[1] + d[1]*d[2] + d[2]*d[0];
+  }
+
+  /// Bin of a centroid along the split axis
+  struct BinOf {
+    BinOf(unsigned int axis, float min, float scale) : m_axis(axis), m_min(min), m_scale(scale) {}
+    unsigned int operator()(const osg::Vec3& c) const
+    {
+      int b = (int)((c[m_axis]-m_min)*m_scale);
+      return b < 0 ? 0 : (b >= NUM_BINS ? NUM_BINS-1 : b);
+    }
+    unsigned int m_axis;
+    float m_min, m_scale;
+  };
+
+  /// True for the handles that go to the left child
+  struct IsLeft {
+    IsLeft(const BinOf& bin_of, unsigned int last_left_bin, const std::vector<osg::Vec3>& centroids) : 
+      m_bin_of(bin_of), m_last_left_bin(last_left_bin), m_centroids(centroids) {}
+    bool operator()(ItemHandle item) const { return m_bin_of(m_centroids[item]) <= m_last_left_bin; }
+    BinOf m_bin_of;
+    unsigned int m_last_left_bin;
+    const std::vector<osg::Vec3>& m_centroids;
+  };
+
+  /// Depth first, the left child of an inner node follows it
+  std::vector<Node> m_nodes;
+
+  /// The items and their bounding boxes in leaf order
+  std::vector<T> m_items;
+  std::vector<osg::BoundingBox> m_item_bounds;
+
+  /// For each handle, its index in m_items
+  std::vector<unsigned int> m_leaf_index;
+
+  /// What queries read, either the vectors above or external data
+  const Node *m_node_data;
+  unsigned int m_num_nodes;
+  const T *m_item_data;
+  const osg::BoundingBox *m_item_bound_data;
+  const unsigned int *m_leaf_index_data;
+  unsigned int m_num_items;
+};
+
+template <class T>
+void BoundingVolumeHierarchy<T>::build(const std::vector<osg::BoundingBox>& bounds, const std::vector<T>& items)
+{
+  clear();
+
+  unsigned int n = osg::minimum(bounds.size(), items.size());
+  if (n == 0)
+    return;
+
+  std::vector<ItemHandle> order(n);
+  std::vector<osg::Vec3> centroids(n);
+  for(unsigned int i=0; i < n; i++) {
+    order[i] = i;
+    centroids[i] = bounds[i].valid() ? bounds[i].center() : osg::Vec3(0,0,0);
+  }
+
+  // A binary tree with leaves of at least one item
+  m_nodes.reserve(2*n);
+  buildNode(0, n, 0, order, bounds, centroids);
+
+  m_items.resize(n);
+  m_item_bounds.resize(n);
+  m_leaf_index.resize(n);
+  for(unsigned int i=0; i < n; i++) {
+    m_items[i] = items[order[i]];
+    m_item_bounds[i] = bounds[order[i]];
+    m_leaf_index[order[i]] = i;
+  }
+  useOwnData();
+}
+
+template <class T>
+unsigned int BoundingVolumeHierarchy<T>::buildNode(unsigned int begin, unsigned int end, unsigned int depth, 
+  std::vector<ItemHandle>& order, const std::vector<osg::BoundingBox>& bounds, const std::vector<osg::Vec3>& centroids)
+{
+  unsigned int index = m_nodes.size();
+  m_nodes.push_back(Node());
+
+  osg::BoundingBox bound, centroid_bound;
+  for(unsigned int i=begin; i < end; i++) {
+    bound.expandBy(bounds[order[i]]);
+    centroid_bound.expandBy(centroids[order[i]]);
+  }
+  m_nodes[index].bound = bound;
+
+  unsigned int mid = end;
+  if (end-begin > MAX_LEAF_SIZE && depth < MAX_DEPTH)
+    mid = split(begin, end, centroid_bound, order, bounds, centroids);
+
+  if (mid == end) {
+    m_nodes[index].offset = begin;
+    m_nodes[index].count = end-begin;
+    return index;
+  }
+
+  // m_nodes may be reallocated by the children, so do not keep a reference to the node
+  buildNode(begin, mid, depth+1, order, bounds, centroids);
+  unsigned int right = buildNode(mid, end, depth+1, order, bounds, centroids);
+  m_nodes[index].offset = right;
+  m_nodes[index].count = 0;
+  return index;
+}
+
+template <class T>
+unsigned int BoundingVolumeHierarchy<T>::split(unsigned int begin, unsigned int end, const osg::BoundingBox& centroid_bound,
+  std::vector<ItemHandle>& order, const std::vector<osg::BoundingBox>& bounds, const std::vector<osg::Vec3>& centroids)
+{
+  // Split along the axis where the centroids are spread the most
+  osg::Vec3 extent = centroid_bound._max-centroid_bound._min;
+  unsigned int axis = 0;
+  if (extent[1] > extent[axis]) axis = 1;
+  if (extent[2] > extent[axis]) axis = 2;
+
+  // All centroids at the same place, any split is as good as another
+  if (extent[axis] <= 0)
+    return begin+(end-begin)/2;
+
+  BinOf bin_of(axis, centroid_bound._min[axis], NUM_BINS*0.9999f/extent[axis]);
+
+  osg::BoundingBox bin_bounds[NUM_BINS];
+  unsigned int bin_counts[NUM_BINS] = { 0 };
+  for(unsigned int i=begin; i < end; i++) {
+    unsigned int b = bin_of(centroids[order[i]]);
+    bin_counts[b]++;
+    bin_bounds[b].expandBy(bounds[order[i]]);
+  }
+
+  // Cost of the right side of each split, sweeping from the right
+  float right_costs[NUM_BINS];
+  osg::BoundingBox right_bound;
+  unsigned int right_count = 0;
+  for(int b=NUM_BINS-1; b > 0; b--) {
+    right_bound.expandBy(bin_bounds[b]);
+    right_count += bin_counts[b];
+    right_costs[b] = right_count ? area(right_bound)*right_count : -1;
+  }
+
+  // Then sweep from the left, the split after bin b is cost(left of b) + cost(right of b)
+  float best_cost = 0;
+  int best_bin = -1;
+  osg::BoundingBox left_bound;
+  unsigned int left_count = 0;
+  for(int b=0; b < NUM_BINS-1; b++) {
+    left_bound.expandBy(bin_bounds[b]);
+    left_count += bin_counts[b];
+    if (!left_count || right_costs[b+1] < 0)
+      continue;
+
+    float cost = area(left_bound)*left_count + right_costs[b+1];
+    if (best_bin < 0 || cost < best_cost) {
+      best_cost = cost;
+      best_bin = b;
+    }
+  }
+
+  if (best_bin < 0)
+    return begin+(end-begin)/2;
+
+  return std::partition(order.begin()+begin, order.begin()+end, IsLeft(bin_of, best_bin, centroids)) - order.begin();
+}
+
+template <class T>
+void BoundingVolumeHierarchy<T>::refit()
+{
+  // Children are stored after their parent
+  for(int i=(int)m_nodes.size()-1; i >= 0; i--) {
+    Node& node = m_nodes[i];
+    node.bound.init();
+    if (node.count) {
+      for(unsigned int j=node.offset; j < node.offset+node.count; j++)
+        node.bound.expandBy(m_item_bounds[j]);
+    }
+    else {
+      node.bound.expandBy(m_nodes[i+1].bound);
+      node.bound.expandBy(m_nodes[node.offset].bound);
+    }
+  }
+}
+
+template <class T>
+unsigned int BoundingVolumeHierarchy<T>::queryNodes(const osg::BoundingBox& box, const osg::Vec3 *center, float radius, 
+  QueryResult& result) const
+{
+  result.m_items.clear();
+  if (!m_num_nodes)
+    return 0;
+
+  // Each level leaves at most one right child on the stack
+  unsigned int stack[MAX_DEPTH+2];
+  unsigned int top = 0;
+  stack[top++] = 0;
+
+  while (top) {
+    unsigned int index = stack[--top];
+    const Node& node = m_node_data[index];
+    if (!overlaps(node.bound, box, center, radius))
+      continue;
+
+    if (node.count) {
+      for(unsigned int i=node.offset; i < node.offset+node.count; i++) {
+        if (overlaps(m_item_bound_data[i], box, center, radius))
+          result.m_items.push_back(&m_item_data[i]);
+      }
+    }
+    else {
+      stack[top++] = node.offset;
+      stack[top++] = index+1;
+    }
+  }
+
+  return result.m_items.size();
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,80 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ForceModelWorker_h__
+#define __osgHaptics_ForceModelWorker_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/ForceOperator.h>
+#include <osgHaptics/ParameterBuffer.h>
+#include <osgHaptics/ServoFrame.h>
+#include <osgSensor/StopThread.h>
+
+#include <osg/ref_ptr>
+#include <OpenThreads/Mutex>
+
+#include <vector>
+
+
+namespace osgHaptics {
+
+  /// Evaluates the ForceOperators with an evaluation rate at that rate, outside of the servo thread.
+
+  /*!
+    Owned by a ServoLoop, which hands over the latest ServoFrame each tick. Each ForceOperator gets
+    calculateForceModel() called about getEvaluationRate() times per second, and the resulting LocalForceModel
+    is published to the servo loop which extrapolates it every tick.
+  */
+  class OSGHAPTICS_EXPORT ForceModelWorker : public vrutils::StopThread {
+  public:
+
+    /// frames is written by the servo thread and only read by this worker
+    ForceModelWorker(ParameterBuffer<ServoFrame> *frames);
+
+    /// Stops the thread
+    virtual ~ForceModelWorker();
+
+    void addForceOperator(ForceOperator *fo);
+    void removeForceOperator(ForceOperator *fo);
+
+    /// Stop the thread and wait for it to finish
+    void close();
+
+  protected:
+    virtual void run();
+
+  private:
+    struct Entry {
+      osg::ref_ptr<ForceOperator> fo;
+      double next_time;
+    };
+
+    // Locked by the worker during each evaluation pass, and by the application when adding/removing
+    std::vector<Entry> m_entries;
+    OpenThreads::Mutex m_mutex;
+
+    ParameterBuffer<ServoFrame> *m_frames;
+    bool m_running;
+  };
+
+} // namespace osgHaptics
+
+#endif
@@ -23,54 +23,123 @@
 
 #include <osg/Referenced>
 #include <OpenThreads/Mutex>
+#include <OpenThreads/Atomic>
 #include <osg/Vec3d>
 #include <osg/Timer>
 #include <osg/Matrix>
 
 #include <osgHaptics/export.h>
+#include <osgHaptics/ParameterBuffer.h>
+#include <osgHaptics/ServoStatistics.h>
+#include <osgHaptics/ServoFrame.h>
+#include <osgHaptics/LocalForceModel.h>
 
 
 
   namespace osgHaptics {
   
     class HapticDevice;
+    class ServoLoop;
+    class ForceModelWorker;
 
+    /// Base class for forces calculated in the servo loop of a HapticDevice.
+
+    /*!
+      calculateForce()/calculateTorque() are called from the servo thread. They must never block,
+      so parameters set from the application are handed over to the servo thread through a ParameterBuffer.
+      m_mutex only serializes the application side setters, it is never locked in the servo loop.
+      The state of the device is given by the ServoFrame, never call hdGet*() from an operator.
+    */
     class OSGHAPTICS_EXPORT ForceOperator : public osg::Referenced {
     public:
-      ForceOperator() : m_trigged(false), m_start(0) , m_duration(0), m_enabled(true) {}
+      ForceOperator() : m_evaluation_rate(0), m_trigged(false), m_trig_serial(0), m_start(0) , m_duration(0), m_enabled(1) {}
 
       friend class HapticDevice;
-      /// Calculate the force this Operator should affect the haptic device
+      friend class ServoLoop;
+      friend class ForceModelWorker;
+      /// Calculate the force this Operator should affect the haptic device. The default calls the deprecated calculateForce().
+      virtual void calculateForce(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out) { calculateForce(in, out, frame.time); }
+
+      /// Calculate the Torque this Operator should affect the haptic device. The default calls the deprecated calculateTorque().
+      virtual void calculateTorque(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out) { calculateTorque(in, out, frame.time); }
+
+      /*!
+        Deprecated, override calculateForce(const ServoFrame&, ...) instead. 
+        Still called for operators written before the ServoFrame, with frame.time as time.
+        Subclasses overriding the ServoFrame overloads add using ForceOperator::calculateForce (and calculateTorque),
+        so that the deprecated overloads are not hidden for existing callers.
+      */
       virtual void calculateForce(const osg::Vec3d& in, osg::Vec3d& out, double time) { out = in; }
 
-      /// Calculate the Torque this Operator should affect the haptic device
+      /// Deprecated, override calculateTorque(const ServoFrame&, ...) instead
       virtual void calculateTorque(const osg::Vec3d& in, osg::Vec3d& out, double time) { out = in; }
 
       /// Enable/disable the effect
-      virtual void setEnable(bool f) { OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex); m_enabled = f; }
+      virtual void setEnable(bool f) { m_enabled.exchange(f ? 1 : 0); }
 
       /// Return wether the force effect is enabled or not
-      bool getEnable() const { OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex); bool f = m_enabled; return f; }
+      bool getEnable() const { return m_enabled != 0; }
+
+      /*!
+        Set how many times per second this operator is evaluated. 0 (default) means at every servo tick.
+        With a rate, calculateForceModel() is called at that rate from a worker thread and the servo loop
+        extrapolates the resulting LocalForceModel at every tick, for operators too expensive for the servo rate.
+        Must be set before the operator is added to a HapticDevice.
+      */
+      void setEvaluationRate(double hz) { m_evaluation_rate = hz; }
+      double getEvaluationRate() const { return m_evaluation_rate; }
+
+      /*!
+        Calculate a LocalForceModel around frame.position, called from the worker thread when getEvaluationRate() > 0.
+        The default implementation calls calculateForce()/calculateTorque() at frame.position, and three more times
+        at displaced positions for a finite difference jacobian. Override it when the jacobian is known
+        or when calculateForce() can not be called several times for the same time.
+      */
+      virtual void calculateForceModel(const ServoFrame& frame, LocalForceModel& model);
     
       /// Enable this effect for a specified time
       void trig(unsigned int milliseconds_duration);
 
-      void setWorldToWorkSpaceMatrix(const osg::Matrix& m);
-      void getWorldToWorkSpaceMatrix(osg::Matrix& m) const;
-      void getWorkspaceToWorldMatrix(osg::Matrix& m) const;
+      /// Return the time spent in calculateForce()+calculateTorque() for each servo tick this operator has been enabled
+      const TimingHistogram& getCostHistogram() const { return m_cost_histogram; }
+
+      /// Clear the cost histogram
+      void resetCostHistogram() { m_cost_histogram.reset(); }
 
     protected:
+      /// Called once per servo tick, disables the effect when a trig() has timed out
       void update();
 
       mutable OpenThreads::Mutex m_mutex;
       virtual ~ForceOperator() {}
-      osg::Matrix m_world_to_workspace_matrix, m_workspace_to_world_matrix;
+
+      double m_evaluation_rate;
 
     private:
+      struct TrigParameters {
+        TrigParameters() : serial(0), start(0), duration(0) {}
+        unsigned int serial;
+        osg::Timer_t start;
+        double duration;
+      };
+
+      // Application side copy of the trig parameters, protected by m_mutex
+      TrigParameters m_trig_parameters;
+      ParameterBuffer<TrigParameters> m_trig_buffer;
+
+      // Servo side state
       bool m_trigged;
+      unsigned int m_trig_serial;
       osg::Timer_t m_start;
       double m_duration;
-      bool m_enabled;
+
+      OpenThreads::Atomic m_enabled;
+
+      // Written by the ForceModelWorker, read by the servo thread
+      ParameterBuffer<LocalForceModel> m_force_model;
+
+      // Written by the servo thread of the HapticDevice
+      TimingHistogram m_cost_histogram;
     };
   } // namespace osgHaptics
 
@@ -39,11 +39,16 @@
 #include <osg/Matrix>
 #include <osg/Vec3>
 #include <OpenThreads/ScopedLock>
+#include <OpenThreads/Atomic>
 
 #include <osgHaptics/export.h>
 #include <osgHaptics/ForceEffect.h>
 #include <osgHaptics/ContactEventHandler.h>
 #include <osgHaptics/ForceOperator.h>
+#include <osgHaptics/ServoLoop.h>
+#include <osgHaptics/ParameterBuffer.h>
+#include <osgHaptics/SimulatedDevice.h>
+#include <osgHaptics/RenderForceFilter.h>
 //#include <osgHaptics/EventHandler.h>
 
 
@@ -62,8 +67,16 @@ class  OSGHAPTICS_EXPORT HapticDevice : public osgSensor::Sensor
 {
 public:
 
+  /*!
+    Create a HapticDevice for the device named pConfigName.
+    With pConfigName=SIMULATED_DEVICE no hardware or HD scheduler is used, the servo loop is instead driven
+    by a SimulatedDevice, see getSimulatedDevice().
+  */
   HapticDevice(HDstring pConfigName=HD_DEFAULT_DEVICE);
 
+  /// Configuration name for a software simulated device
+  static const char *SIMULATED_DEVICE;
+
   enum InterpolationMode { 
     NO_INTERPOLATION, 
     LINEAR_INTERPOLATION, 
@@ -126,6 +139,16 @@ public:
   void setInterpolationMode(InterpolationMode mode);
   inline InterpolationMode getInterpolationMode( void ) const { return m_interpolation_mode; }
 
+  enum FilterType { BARTLETT,  HANNING, HAMMING, RECTANGULAR, BLACKMAN };
+
+  /*!
+    Set the FIR lowpass filter used with FILTER_INTERPOLATION: the window, the cutoff (relative to half the servo rate)
+    and the number of coefficients (at most RenderForceFilter::MAX_TAPS). Takes effect when recalc is true.
+  */
+  void setFilterType(FilterType f, bool recalc=false) { m_filter_type = f; if (recalc) recalculateFilter(); }
+  void setCutoff(double c, bool recalc=false) { m_cutoff = c; if (recalc) recalculateFilter(); }
+  void setFilterWindowSize(unsigned int size, bool recalc=false) { m_filter_window_size = size; if (recalc)  recalculateFilter(); }
+
   /// returns the name of this class
   virtual const char *className() { return "HapticDevice"; }
 
@@ -205,6 +228,13 @@ public:
   void setEnableForceClamping(bool enabled);
   bool getEnableForceClamping() const { return m_force_clamping_enabled; }
 
+  /*!
+    Let HL render the shapes into a small viewport around the proxy instead of the whole haptic camera view.
+    Required for depth buffer shapes to be cheap, see Shape::setShapeType()
+  */
+  void setEnableAdaptiveViewport(bool enabled);
+  bool getEnableAdaptiveViewport() const { return m_adaptive_viewport_enabled; }
+
   void getMaxWorkspace(osg::Vec3& min, osg::Vec3& max);
 
   class RenderForce {
@@ -230,6 +260,10 @@ public:
 
   void createContext();
 
+  /*!
+    Set a force (in world coordinates) to render in addition to the ForceOperators. Meant to be called once per frame,
+    the servo loop brings it up to the servo rate according to the InterpolationMode, see RenderForceFilter.
+  */
   void setRenderForce(const osg::Vec3& force);
   void getRenderForce(RenderForce &rforce ) const;
   void setTouchToWorldMatrix(const osg::Matrix& m) { m_touch_to_world_matrix = m; }
@@ -274,25 +308,63 @@ public:
 
   /*!
     Add a ForceOperator to the list of active ForceOperators so that it will be processed.
+    The servo loop picks up the new set of ForceOperators at its next tick, it is never blocked by this call.
     \param fo - A pointer to the forceoperator that will be processed.
   */
-  void addForceOperator(ForceOperator *fo);
+  void addForceOperator(ForceOperator *fo) { m_servo_loop->addForceOperator(fo); }
 
   /*!
     Remove a ForceOperator. After this call the ForceOperator will not be activated.
     \param fo - A pointer to the ForceOperator to be removed
   */
-  void removeForceOperator(ForceOperator *fo);
+  void removeForceOperator(ForceOperator *fo) { m_servo_loop->removeForceOperator(fo); }
+
+  /// Return the ServoLoop that evaluates the ForceOperators of this device
+  ServoLoop *getServoLoop() { return m_servo_loop.get(); }
+
+  /*!
+    Return the timing of the servo loop: duration of each tick and the period between ticks.
+    Can be queried at any time from any thread, the servo loop never blocks on it.
+    The cost of each ForceOperator is available through ForceOperator::getCostHistogram()
+  */
+  const ServoStatistics& getServoStatistics() const { return m_servo_loop->getServoStatistics(); }
+
+  /// Clear the servo loop statistics, including the cost histograms of the added ForceOperators
+  void resetServoStatistics() { m_servo_loop->resetServoStatistics(); }
+
+  /// Print p50/p99/max of the servo loop timing and of each added ForceOperator
+  void printServoStatistics(std::ostream& os) { m_servo_loop->printServoStatistics(os); }
+
+  /*!
+    Start recording the state of the device at each servo tick to a binary trace file.
+    Each TraceRecord holds everything read from the device (ServoInput) together with the resulting force and torque,
+    so the trace can be replayed offline with ServoReplay.
+    The servo loop only copies a TraceRecord into a ring buffer of buffer_size records, the file
+    is written by a background thread. Use ServoTraceReader to read the file.
+    Any trace already running is stopped first.
+    \return false if the file could not be opened
+  */
+  bool startTrace(const std::string& filename, unsigned int buffer_size=16384) { return m_servo_loop->startTrace(filename, buffer_size); }
+
+  /// Stop the current trace, write the remaining records and close the file
+  void stopTrace() { m_servo_loop->stopTrace(); }
+
+  /// Return true if a trace is being recorded
+  bool isTracing() const { return m_servo_loop->isTracing(); }
+
+  /// Read the current state of the device from the HD API. Must be called from within the HD scheduler thread.
+  static void readServoInput(ServoInput& input);
 
 
-  /// 
+  /// Set the world to workspace matrix, also published to the servo thread without blocking it
   void setWorldToWorkSpaceMatrix(const osg::Matrix& m) { 
     OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_world_to_workspace_matrix_mutex);
     m_world_to_workspace_matrix = m; 
     m_valid_world_to_workspace_matrix = true;
+    m_workspace_buffer.write(WorkspaceParameters(m));
   }
 
-  /// 
+  /// Return false if the matrix has not been set yet. Application side, the servo thread reads m_workspace_buffer.
   bool getWorldToWorkSpaceMatrix(osg::Matrix& m) const { 
     OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_world_to_workspace_matrix_mutex);
     bool b = m_valid_world_to_workspace_matrix;
@@ -306,11 +378,54 @@ public:
     \param flag - If true shapes will be rendered haptically
   */
   void setEnableShapeRender(bool flag) { m_enable_shape_render = flag; }
-  bool getEnableShapeRender() const { return m_enable_shape_render; }
+
+  /// Shapes are rendered with HL, so they are never rendered for a simulated device
+  bool getEnableShapeRender() const { return m_enable_shape_render && !isSimulated(); }
+
+  /*!
+    Set the radius around the proxy, in world coordinates, within which the triangles of haptic geometries
+    are sent to HL. 0 (default) sends all triangles.
+  */
+  void setCullRadius(float radius) { m_cull_radius = radius; }
+  float getCullRadius() const { return m_cull_radius; }
+
+  /// Set the time (s) the proxy is extrapolated along its velocity when culling, the culled region covers the sweep
+  void setCullLookAhead(float seconds) { m_cull_look_ahead = seconds; }
+  float getCullLookAhead() const { return m_cull_look_ahead; }
+
+  /// Set the largest number of culled triangles sent to HL per frame, the ones closest to the proxy are kept. 0 (default) means no limit.
+  void setMaxCulledTriangles(unsigned int max) { m_max_culled_triangles = max; }
+  unsigned int getMaxCulledTriangles() const { return m_max_culled_triangles; }
+
+  /*!
+    Set the distance from the proxy, in world coordinates, beyond which haptic geometries are sent to HL 
+    simplified, if they have levels of detail (see HapticRenderPrepareVisitor::setNumLODs()). Each doubling 
+    of the distance selects the next, coarser, level. 0 (default) always sends the full triangles.
+  */
+  void setLODDistance(float distance) { m_lod_distance = distance; }
+  float getLODDistance() const { return m_lod_distance; }
+
+  /// Return true if this device was created with SIMULATED_DEVICE
+  bool isSimulated() const { return m_simulated_device.valid(); }
+
+  /// Return the simulated end effector and scheduler, 0 for a hardware device
+  SimulatedDevice *getSimulatedDevice() { return m_simulated_device.get(); }
+
+  /*!
+    Run one tick of the servo loop with the state of the device in input, and return the force and torque to apply.
+    Called from the servo thread: by the HD scheduler for a hardware device, or by the SimulatedDevice.
+  */
+  void runServoTick(const ServoInput& input, osg::Vec3d& force, osg::Vec3d& torque);
 
   /// Return the square of maximum force the device can deliver
   double getMaxForce2() const { return m_max_force*m_max_force; }
 
+  /// Return the maximum force the device can deliver, 0 until the device is initialized
+  double getMaxForce() const { return m_max_force; }
+
+  /// Return the nominal force the device can deliver continuously, 0 until the device is initialized
+  double getMaxContinuousForce() const { return m_max_continuous_force; }
+
 
   /*!
     Set the min and max extents of a haptic workspace we want to work in.
@@ -419,15 +534,8 @@ protected:
                                            HLcache *cache,
                                            void *data );
 
- std::ofstream& getLogStream() { return m_log_stream; }
-
   static double getTimeStamp();
 
-  enum FilterType { BARTLETT,  HANNING, HAMMING, RECTANGULAR, BLACKMAN };
-  void setFilterType(FilterType f, bool recalc=false) { m_filter_type = f; if (recalc) recalculateFilter(); }
-  void setCutoff(double c, bool recalc=false) { m_cutoff = c; if (recalc) recalculateFilter(); }
-  void setFilterWindowSize(unsigned int size, bool recalc=false) { m_filter_window_size = size; if (recalc)  recalculateFilter(); }
-
   void setTime(float time) { m_time = time; }
   float getTime() const { return m_time;} 
 
@@ -498,7 +606,6 @@ private:
 //  typedef std::map<EventHandler *, osg::ref_ptr<EventHandler> > EventHandlerMap;
  // EventHandlerMap m_event_handlers;
 
-  std::ofstream m_log_stream;
   InterpolationMode m_interpolation_mode;
 
   typedef std::vector<double> FilterCoefficients;
@@ -521,11 +628,13 @@ private:
   bool recalculateFilter();
   bool calculateFilterCoefficients( FilterCoefficients& coefficients, unsigned int M, double cutoff, enum FilterType filter_type );
 
-  template<class T>
-  T filter( std::vector<T>& in_data, FilterCoefficients& coefficients );
+  /// Smooths the force from setRenderForce() in the servo loop
+  osg::ref_ptr<RenderForceFilter> m_render_force_filter;
+
+  /// Hand the interpolation mode and filter coefficients over to m_render_force_filter
+  void updateRenderForceFilter();
 
   friend class ForceEffect;
-  std::vector<osg::Vec3> m_rendering_forces;
   void pushForceEffectOperation(ForceEffect *effect, ForceEffect::Operation op);
   bool executeForceEffectOperationQueue();
   void updateForceEffects();
@@ -533,9 +642,15 @@ private:
   typedef std::queue<std::pair<ForceEffect::Operation, osg::ref_ptr<ForceEffect> >  >ForceEffectQueue;
   ForceEffectQueue m_force_effect_queue;
 
-  typedef std::map<ForceOperator *, osg::ref_ptr<ForceOperator> > ForceOperatorMap;
-  ForceOperatorMap m_force_operators;
-  OpenThreads::Mutex m_fo_mutex;
+  /// Evaluates the ForceOperators, keeps statistics and traces. Its tick() is called from forceEffectCB.
+  osg::ref_ptr<ServoLoop> m_servo_loop;
+
+  /// Replaces the HD API and scheduler when created with SIMULATED_DEVICE
+  friend class SimulatedDevice;
+  osg::ref_ptr<SimulatedDevice> m_simulated_device;
+
+  /// Update the button state of a simulated device and send button events
+  void updateSimulatedButtons(int buttons);
 
   OpenThreads::Mutex m_modelview_mutex;
   osg::Matrix m_modelview_matrix;
@@ -544,10 +659,26 @@ private:
   osg::Matrix m_world_to_workspace_matrix;
   bool m_valid_world_to_workspace_matrix;
 
+  /// The world to workspace matrix as seen by the servo thread
+  struct WorkspaceParameters {
+    WorkspaceParameters() : valid(false) {}
+    WorkspaceParameters(const osg::Matrix& m) : world_to_workspace(m), valid(true) {}
+    osg::Matrix world_to_workspace;
+    bool valid;
+  };
+
+  // Written with m_world_to_workspace_matrix_mutex held, read by runServoTick()
+  ParameterBuffer<WorkspaceParameters> m_workspace_buffer;
+
   double m_proxy_damping, m_proxy_stiffness;
   bool m_shutting_down;
   bool m_enable_shape_render;
+  bool m_adaptive_viewport_enabled;
+  float m_cull_radius, m_cull_look_ahead;
+  unsigned int m_max_culled_triangles;
+  float m_lod_distance;
   double m_max_force;
+  double m_max_continuous_force;
   DeviceModel m_device_model;
   WorkspaceModel m_workspace_model;
 
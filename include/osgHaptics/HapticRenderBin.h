@@ -23,8 +23,10 @@
 
 #include <osgHaptics/export.h>
 #include <osgUtil/RenderBin>
+#include <osg/GL>
 #include <osgHaptics/HapticRenderLeaf.h>
 #include <osgHaptics/Shape.h>
+#include <osgHaptics/TriangleSet.h>
 
 
 
@@ -52,6 +54,21 @@
 		/// It the state has a shape attached, then return it
 		const osgHaptics::Shape *getShape(osg::RenderInfo& renderInfo) const;
 
+		/*!
+		  Render only the triangles of drawable within the cull radius of the proxy of device.
+		  \param modelview - The matrix from the local coordinates of drawable to eye coordinates
+		*/
+		void renderCulled(const osg::Drawable& drawable, const HapticDevice& device, const osg::Matrix& modelview,
+		  osg::RenderInfo& renderInfo);
+
+		/*!
+		  Return the level of detail of triangles to send to HL for device, from the distance between drawable and the proxy.
+		  See HapticDevice::setLODDistance(). 
+		  \param modelview - The matrix from the local coordinates of drawable to eye coordinates
+		*/
+		unsigned int selectLOD(const osg::Drawable& drawable, const TriangleSet& triangles, const HapticDevice& device, 
+		  const osg::Matrix& modelview, osg::RenderInfo& renderInfo) const;
+
 	protected:
 
 		void renderHapticLeaf(osgUtil::RenderLeaf* original, osg::RenderInfo& renderInfo, osgUtil::RenderLeaf *previous); 
@@ -67,6 +84,14 @@
 		
 		ShapeDeviceMap m_rendered_shapes;
 
+		/// Number of culled triangles rendered this frame for each device
+		typedef std::map<const osgHaptics::HapticDevice *, unsigned int> TriangleCountMap;
+		TriangleCountMap m_num_culled_triangles;
+
+		TriangleSet::Hierarchy::QueryResult m_cull_result;
+		std::vector<unsigned int> m_culled_triangles;
+		std::vector<GLuint> m_culled_indices;
+
 
 		int m_last_frame;
 	};
@@ -86,11 +86,20 @@
       Prepares this visitor to traverse yet another run.
     */
     void reset() { m_shape = 0L; }
+
+    /*!
+      Build num_levels haptic levels of detail for each drawable, each level with reduction times the triangles
+      of the previous one. See TriangleSet::buildLODs() and HapticDevice::setLODDistance(). Default 1, no simplification.
+    */
+    void setNumLODs(unsigned int num_levels, float reduction=0.25f) { m_num_lods = num_levels; m_lod_reduction = reduction; }
+    unsigned int getNumLODs() const { return m_num_lods; }
     
 
   protected:
     osg::ref_ptr<ShapeComposite> m_shape;
     osg::observer_ptr<HapticDevice> m_device;
+    unsigned int m_num_lods;
+    float m_lod_reduction;
 
   };
 } // namespace osgHaptics
@@ -5,40 +5,105 @@
 #include <osg/BoundingBox>
 #include <osg/Vec3>
 #include <vector>
-#include <set>
-#include <map>
+#include <algorithm>
+#include <utility>
 #include <osg/ref_ptr>
+#include <osg/Math>
+#include <OpenThreads/Thread>
+#include <math.h>
 
 namespace osgHaptics {
 template <class T>
 
 /// A class to hash data into a spatial hashed grid No explicit grid is stored
 
+/*!
+  Data items are added with insert() and become visible to intersect() after finalize().
+  finalize() packs all items into one contiguous array sorted by cell (CSR style), and the cells
+  into a flat open addressed table where each slot holds the cell key and its range in the item array.
+  A query then probes a few slots of the table and reads each cell sequentially, instead of walking a tree
+  and following a pointer per cell.
+
+  intersect() returns the cells around a point, an item can appear in several of them. query() visits the cells
+  overlapping an arbitrary box or sphere and returns every item once. It marks visited items with the epoch
+  of the caller's QueryResult instead of building a set, so a reused QueryResult makes queries allocation free.
+
+  For large meshes, build() replaces insert() and finalize(). It registers each item in every cell its bounding box
+  overlaps, computes the cell keys on several threads and groups them with a radix sort.
+
+  Items added with build() or add() are identified by an ItemHandle and can be moved and removed later. Such changes
+  only mark the cells of the old and new bounding box as dirty, update() then rewrites just those cells. Rewritten
+  cells are appended to the item array, which is compacted once more than half of it is stale.
+
+  Each cell is identified by the Morton (Z-order) code of its integer coordinates, so distinct cells never
+  share a key, and cells that are close in space are close in the item array. The grid has at most
+  MAX_HASH_SIZE cells along each axis, cells outside the grid are rejected instead of wrapping around.
+*/
 class HashedGrid : public osg::Referenced
   {
   public:
     HashedGrid(const osg::Vec3& dimension, unsigned int hash_size=100) : m_dimension(dimension),
-      m_hash_size(hash_size)
+      m_hash_size(hash_size), m_num_cells(0), m_num_stale_items(0)
     {
       setHashSize(m_hash_size);
     }
     
     
-    struct HashedDataVector : public std::set<T>, public osg::Referenced {
-    
-      
+    /// The data items of one cell, a range in the item array of the grid. Invalidated by finalize() and clear().
+    class Cell {
+    public:
+      typedef const T * const_iterator;
+
+      Cell() : m_begin(0L), m_end(0L) {}
+      Cell(const T *begin, const T *end) : m_begin(begin), m_end(end) {}
+
+      const_iterator begin() const { return m_begin; }
+      const_iterator end() const { return m_end; }
+      unsigned int size() const { return m_end-m_begin; }
+      bool empty() const { return m_begin == m_end; }
+
+    private:
+      const T *m_begin, *m_end;
     };
 
-    typedef std::map< unsigned long, osg::ref_ptr<HashedDataVector> > HashMap;
-    typedef std::vector< const HashedDataVector * > HashVector;
+    typedef std::vector< Cell > HashVector;
+
+    /// Deduplicated items found by query(). Reuse one instance across queries, it keeps its memory.
+    class QueryResult {
+    public:
+      typedef typename std::vector<const T *>::const_iterator const_iterator;
 
-    typedef typename HashMap::iterator iterator;
-    typedef typename HashMap::const_iterator const_iterator;
+      QueryResult() : m_epoch(0) {}
 
-    typedef typename HashMap::const_reference const_reference;
+      /// The items point into the grid and are invalidated by finalize() and clear()
+      const_iterator begin() const { return m_items.begin(); }
+      const_iterator end() const { return m_items.end(); }
+      unsigned int size() const { return m_items.size(); }
+      bool empty() const { return m_items.empty(); }
+      const T& operator[](unsigned int i) const { return *m_items[i]; }
 
-    /// Set the resolution of the hashed grid (cell size == dimension/HashSize)
-    void setHashSize(unsigned int l) { m_hash_size = l; }
+    private:
+      friend class HashedGrid<T>;
+
+      std::vector<const T *> m_items;
+
+      /// An item is already in m_items if its stamp equals m_epoch
+      std::vector<unsigned int> m_stamps;
+      unsigned int m_epoch;
+    };
+
+    /// Identifies a cell, the interleaved bits of its x, y and z coordinates
+    typedef unsigned int CellKey;
+
+    /// Largest number of cells along an axis, a CellKey has 10 bits per axis
+    enum { MAX_HASH_SIZE = 1024 };
+
+    /// Set the resolution of the hashed grid (cell size == dimension/HashSize). Takes effect for items inserted after the call.
+    void setHashSize(unsigned int l) { m_hash_size = l < 1 ? 1 : (l > MAX_HASH_SIZE ? (unsigned int)MAX_HASH_SIZE : l); }
+    unsigned int getHashSize() const { return m_hash_size; }
+
+    /// Return the size of one cell
+    osg::Vec3 getCellSize() const { return m_dimension / (float)m_hash_size; }
   
     /// Set the dimension of the hashed grid
     void setDimension(const osg::Vec3& dim){ m_dimension = dim; }
@@ -56,8 +121,69 @@ class HashedGrid : public osg::Referenced
     /// Set the center of the Grid
     void setCenter(const osg::Vec3& center){ m_center = center; }
 
-    /// Insert a datapoint into the grid, it will be hashed into the hashvector
-    void insert(const osg::Vec3&, T data);
+    /*!
+      Insert a datapoint into the grid, it will not be found by intersect() until finalize() is called.
+      \returns false if p is outside of the grid, then nothing is inserted
+    */
+    bool insert(const osg::Vec3& p, T data);
+
+    /// Build the cell table from all inserted data items. Must be called after insert() and before intersect().
+    void finalize();
+
+    /*!
+      Replace the content of the grid with items, each one registered in every cell its bounding box overlaps.
+      The grid is ready for queries afterwards, finalize() is not needed. Bounding boxes are clipped to the grid,
+      items entirely outside of it are not stored.
+
+      \param bounds - The bounding box of each item
+      \param items - The items, items[i] is bounded by bounds[i]. Each item should occur once.
+      \param num_threads - Number of threads computing cell keys, 0 means one per processor
+    */
+    void build(const std::vector<osg::BoundingBox>& bounds, const std::vector<T>& items, unsigned int num_threads=0);
+
+    /// Stable identifier of an item added with build() or add(). The items passed to build() get the handles 0..n-1.
+    typedef unsigned int ItemHandle;
+
+    /*!
+      Add an item in every cell its bounding box overlaps. It will not be found by queries until update() is called.
+      \returns the handle of the new item, handles are not reused until build(), clear() or a finalize() with new
+      inserted points renumbers the items
+    */
+    ItemHandle add(const osg::BoundingBox& bound, T data);
+
+    /// Move the item to the cells overlapped by bound, visible after update(). Returns false for an invalid handle.
+    bool move(ItemHandle item, const osg::BoundingBox& bound);
+
+    /// Remove the item, visible after update(). Returns false for an invalid handle.
+    bool remove(ItemHandle item);
+
+    /// Rewrite the cells touched by add(), move() and remove() since the last update()
+    void update();
+
+    /// Return true if there are no changes waiting for update()
+    bool isUpdated() const { return m_dirty.empty(); }
+
+    /// Return the item with handle
+    const T& getItem(ItemHandle item) const { return m_unique[item]; }
+
+    /// Return true if all inserted data items are visible to intersect()
+    bool isFinalized() const { return m_staged.empty(); }
+
+    /// Return the number of non empty cells
+    unsigned int getNumCells() const { return m_num_cells; }
+
+    /// Return the number of stored data items, an item inserted into several cells is counted once for each cell
+    unsigned int getNumItems() const { return m_items.size()-m_num_stale_items; }
+
+    /// Return the number of distinct stored data items, including the ones removed since the last renumbering
+    unsigned int getNumUniqueItems() const { return m_unique.size(); }
+
+    /// Return the approximate number of bytes used by the grid
+    unsigned int getMemoryUsage() const
+    {
+      return m_slots.capacity()*sizeof(Slot) + m_items.capacity()*sizeof(T) + m_item_ids.capacity()*sizeof(unsigned int) +
+        m_unique.capacity()*sizeof(T) + m_ranges.capacity()*sizeof(ItemRange) + m_staged.capacity()*sizeof(StagedItem);
+    }
 
     /*!
       Get a vector with all data items that are in the cell of the point p + all the 26 neighbours
@@ -72,144 +198,782 @@ class HashedGrid : public osg::Referenced
     {
       int x,y,z;
       // Now we know at what cell we are, lets find the neighbour cells to.
+      // The cell of p itself can be outside the grid, some of its neighbours might still be inside.
       calcCell(p, x,y,z);
-      //std::cerr << "Pos: " << x << "; " << y << "; " << z << std::endl;
-
-      // All neighbours
-      const int table_size = 27;
-      int table[table_size][3] ={
-        {0,0,0},
-        {-1,-1,0},
-        {-1,0,0},
-        {-1,1,0},
-
-        {0,1,0},
-        {1,1,0},
-        {1,0,0},
-
-        {1,-1,0},
-        {0,-1,0},
-        // z=1
-        {0,0,1},
-        {-1,-1,1},
-        {-1,0,1},
-        {-1,1,1},
-
-        {0,1,1},
-        {1,1,1},
-        {1,0,1},
-
-        {1,-1,1},
-        {0,-1,1},
-        // z=-1
-        {0,0,-1},
-        {-1,-1,-1},
-        {-1,0,-1},
-        {-1,1,-1},
-
-        {0,1,-1},
-        {1,1,-1},
-        {1,0,-1},
-
-        {1,-1,-1},
-        {0,-1,-1}     
-      };
-
-      // FOr all neighbours, see if we can find any dataitems
-      for(int i=0; i < table_size; i++) {
-        unsigned int cell[3] = {table[i][0]+x, table[i][1]+y, table[i][2]+z};
-        
-        if (cell[0] < 0 ||cell[0] > m_hash_size ||
-            cell[1] < 0 ||cell[1] > m_hash_size ||
-            cell[2] < 0 ||cell[2] > m_hash_size) {
-            
-              //std::cerr << "Outside: "  << " " << "Cell: " << cell[0] << ", " << cell[1] << ", " << cell[2] << std::endl;
-              continue;
-        }
 
-        unsigned long idx = computeHashBucketIndex(cell[0],cell[1],cell[2]);
+      // For all 27 neighbours, see if we can find any dataitems
+      for(int dz=-1; dz <= 1; dz++) {
+        for(int dy=-1; dy <= 1; dy++) {
+          for(int dx=-1; dx <= 1; dx++) {
+            int cx = x+dx, cy = y+dy, cz = z+dz;
+            if (!isValidCell(cx, cy, cz))
+              continue;
 
-        //std::cerr << "Intersecting dded: " << idx << ": " << cell[0] << ", " << cell[1] << ", " << cell[2] << std::endl;
-        const_iterator it = m_hash_vector.find(idx);
-        if (it != m_hash_vector.end()) {
-          if (it->second->size())
-            result_vector.push_back(it->second.get());
+            const Slot *slot = findSlot(computeCellKey(cx, cy, cz));
+            if (slot)
+              result_vector.push_back(Cell(&m_items[slot->begin], &m_items[slot->begin]+slot->count));
+          }
         }
       }
           
       return result_vector.size() > 0;
     }
 
-    unsigned long computeHashBucketIndex(      
-      const  int& x, 
-      const  int& y, 
-      const  int& z) const;
-  
-    void calcCell(const osg::Vec3& p, int& x, int& y, int& z) const
+    /*!
+      Get all data items in the cells that overlap box, each item is returned once.
+      Items are found by the cell they were inserted into, so expand box by the extent of the items
+      if they are larger than a point.
+
+      \param box - The region to search
+      \param result - Cleared and filled with the items found
+      \returns the number of items found
+    */
+    unsigned int query(const osg::BoundingBox& box, QueryResult& result) const
     {
-      // calculate the integer position from the float position
-      float dx = m_dimension[0] / m_hash_size; 
-      float dy = m_dimension[1] / m_hash_size; 
-      float dz = m_dimension[2] / m_hash_size; 
+      return queryCells(box._min, box._max, 0L, 0, result);
+    }
 
-      // Now calculate which voxel we are using here.
-      x = (p[0]-m_center[0]+m_dimension[0]*0.5)/dx;
-      y = (p[1]-m_center[1]+m_dimension[1]*0.5)/dy;
-      z = (p[2]-m_center[2]+m_dimension[2]*0.5)/dz;
+    /*!
+      Get all data items in the cells that overlap the sphere with center and radius, each item is returned once.
+      \returns the number of items found
+    */
+    unsigned int query(const osg::Vec3& center, float radius, QueryResult& result) const
+    {
+      osg::Vec3 r(radius, radius, radius);
+      return queryCells(center-r, center+r, &center, radius, result);
+    }
 
+    /// Return the Morton code of the cell (x,y,z), which must be a valid cell
+    static CellKey computeCellKey(int x, int y, int z)
+    {
+      return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
     }
 
-    iterator begin() { return m_hash_vector.begin(); }
-    iterator end() { return m_hash_vector.end(); }
+    /// Return true if (x,y,z) is a cell within the grid
+    bool isValidCell(int x, int y, int z) const
+    {
+      return x >= 0 && y >= 0 && z >= 0 && 
+        x < (int)m_hash_size && y < (int)m_hash_size && z < (int)m_hash_size;
+    }
 
-    const_iterator begin() const { return m_hash_vector.begin(); }
-    const_iterator end() const { return m_hash_vector.end(); }
+    /*!
+      Calculate the cell of p. The result is outside the valid range [0,HashSize) if p is outside the grid,
+      except that points on the upper boundary belong to the last cell.
+    */
+    void calcCell(const osg::Vec3& p, int& x, int& y, int& z) const
+    {
+      x = calcCell(p[0], 0);
+      y = calcCell(p[1], 1);
+      z = calcCell(p[2], 2);
+    }
 
-    void clear() { m_hash_vector.clear(); }
+    void clear() 
+    { 
+      m_staged.clear(); 
+      m_slots.clear(); 
+      m_items.clear(); 
+      m_item_ids.clear();
+      m_unique.clear();
+      m_ranges.clear();
+      m_dirty.clear();
+      m_moved.clear();
+      m_num_cells = 0;
+      m_num_stale_items = 0;
+    }
     
   private:
-    unsigned int m_hash_size;
-    HashMap m_hash_vector;
+
+    /// Calculate the cell coordinate along axis
+    int calcCell(float p, unsigned int axis) const
+    {
+      // A flat grid has a single layer of cells along that axis
+      float cell_size = m_dimension[axis] / m_hash_size;
+      if (cell_size <= 0)
+        return 0;
+
+      float u = (p-m_center[axis]+m_dimension[axis]*0.5f)/cell_size;
+      if (u >= m_hash_size && u <= m_hash_size*1.0001f)
+        return m_hash_size-1;
+
+      return (int)floor(u);
+    }
+
+    /// Insert two zero bits between each of the 10 lowest bits of v
+    static CellKey spreadBits(int v)
+    {
+      CellKey x = (CellKey)v & 0x3ff;
+      x = (x | (x << 16)) & 0x030000ff;
+      x = (x | (x << 8))  & 0x0300f00f;
+      x = (x | (x << 4))  & 0x030c30c3;
+      x = (x | (x << 2))  & 0x09249249;
+      return x;
+    }
+
+    /// Inverse of spreadBits(), gather every third bit of key
+    static int compactBits(CellKey key)
+    {
+      CellKey x = key & 0x09249249;
+      x = (x | (x >> 2))  & 0x030c30c3;
+      x = (x | (x >> 4))  & 0x0300f00f;
+      x = (x | (x >> 8))  & 0x030000ff;
+      x = (x | (x >> 16)) & 0x3ff;
+      return (int)x;
+    }
+
+    /// A cell in the open addressed table, count == 0 marks an empty slot
+    struct Slot {
+      Slot() : key(0), begin(0), count(0) {}
+      CellKey key;
+      unsigned int begin, count;
+    };
+
+    /// Index of the first slot to probe for key, the table size is a power of two
+    unsigned int homeSlot(CellKey key) const
+    {
+      // Morton codes of neighbouring cells differ in the low bits only, mix them into the high bits
+      unsigned int h = key*0x9E3779B1u;
+      return (h ^ (h >> 15)) & (m_slots.size()-1);
+    }
+
+    /// Return the slot of the cell with key, 0L if the cell is empty
+    const Slot *findSlot(CellKey key) const
+    {
+      int s = findSlotIndex(key);
+      return s < 0 ? 0L : &m_slots[s];
+    }
+
+    /// Return the index of the slot of the cell with key, -1 if the cell is empty
+    int findSlotIndex(CellKey key) const
+    {
+      if (m_slots.empty())
+        return -1;
+
+      unsigned int mask = m_slots.size()-1;
+      for(unsigned int i = homeSlot(key); m_slots[i].count; i = (i+1) & mask) {
+        if (m_slots[i].key == key)
+          return i;
+      }
+      return -1;
+    }
+
+    /// Calculate the cells [lo,hi] overlapped by the box min,max clipped to the grid. Returns false if none are.
+    bool calcCellRange(const osg::Vec3& min, const osg::Vec3& max, int lo[3], int hi[3]) const
+    {
+      calcCell(min, lo[0], lo[1], lo[2]);
+      calcCell(max, hi[0], hi[1], hi[2]);
+
+      int last = m_hash_size-1;
+      for(unsigned int a=0; a < 3; a++) {
+        if (hi[a] < 0 || lo[a] > last)
+          return false;
+        lo[a] = osg::maximum(lo[a], 0);
+        hi[a] = osg::minimum(hi[a], last);
+      }
+      return true;
+    }
+
+    unsigned int queryCells(const osg::Vec3& min, const osg::Vec3& max, const osg::Vec3 *center, float radius, QueryResult& result) const;
+
+    /// Add the items of slot that are not yet in result
+    void addItems(const Slot& slot, QueryResult& result) const
+    {
+      for(unsigned int i=slot.begin; i < slot.begin+slot.count; i++) {
+        unsigned int id = m_item_ids[i];
+        if (result.m_stamps[id] != result.m_epoch) {
+          result.m_stamps[id] = result.m_epoch;
+          result.m_items.push_back(&m_unique[id]);
+        }
+      }
+    }
+
+    /// Return true if the cell (x,y,z) overlaps the sphere with center and radius
+    bool cellIntersectsSphere(int x, int y, int z, const osg::Vec3& center, float radius) const
+    {
+      int cell[3] = { x, y, z };
+      float d2 = 0;
+      for(unsigned int a=0; a < 3; a++) {
+        float cell_size = m_dimension[a] / m_hash_size;
+        float lo = m_center[a] - m_dimension[a]*0.5f + cell[a]*cell_size;
+        float d = center[a] < lo ? lo-center[a] : (center[a] > lo+cell_size ? center[a]-lo-cell_size : 0);
+        d2 += d*d;
+      }
+      return d2 <= radius*radius;
+    }
+
+    /// Allocate an empty table for num_cells cells, at most half full so that probe sequences stay short
+    void allocateTable(unsigned int num_cells)
+    {
+      unsigned int table_size = 16;
+      while (table_size < 2*num_cells)
+        table_size *= 2;
+
+      m_slots.assign(table_size, Slot());
+      m_num_cells = num_cells;
+    }
+
+    /// Add the cell key with the items [begin, begin+count) to the table
+    void addSlot(CellKey key, unsigned int begin, unsigned int count)
+    {
+      unsigned int mask = m_slots.size()-1;
+      unsigned int s = homeSlot(key);
+      while (m_slots[s].count)
+        s = (s+1) & mask;
+
+      m_slots[s].key = key;
+      m_slots[s].begin = begin;
+      m_slots[s].count = count;
+    }
+
+    /// Remove slot s, moving later slots of the same probe sequence back so that no probe sequence is broken
+    void removeSlot(unsigned int s)
+    {
+      unsigned int mask = m_slots.size()-1;
+      for(unsigned int i = (s+1) & mask; m_slots[i].count; i = (i+1) & mask) {
+        // A slot can fill the hole if the hole is between its home slot and the slot itself
+        unsigned int home = homeSlot(m_slots[i].key);
+        bool stays = s <= i ? (s < home && home <= i) : (s < home || home <= i);
+        if (!stays) {
+          m_slots[s] = m_slots[i];
+          s = i;
+        }
+      }
+      m_slots[s] = Slot();
+    }
+
+    /// Rebuild the table with room for num_cells cells
+    void resizeTable(unsigned int num_cells)
+    {
+      std::vector<Slot> slots;
+      slots.swap(m_slots);
+      unsigned int current_cells = m_num_cells;
+      allocateTable(num_cells);
+      for(unsigned int s=0; s < slots.size(); s++) {
+        if (slots[s].count)
+          addSlot(slots[s].key, slots[s].begin, slots[s].count);
+      }
+      m_num_cells = current_cells;
+    }
+
+    /// The cells an item added with build() or add() overlaps
+    struct ItemRange {
+      ItemRange() : tracked(false), inside(false), moved(false) {}
+
+      /// Return true if the item belongs to cell (x,y,z), items without a known range stay where they are
+      bool contains(int x, int y, int z) const
+      {
+        if (!tracked)
+          return true;
+        return inside && x >= lo[0] && x <= hi[0] && y >= lo[1] && y <= hi[1] && z >= lo[2] && z <= hi[2];
+      }
+
+      int lo[3], hi[3];
+
+      /// False for items from insert(), their cells are not known
+      bool tracked;
+
+      /// False if the item is removed or outside of the grid
+      bool inside;
+
+      /// True if the item changed cells since the last update()
+      bool moved;
+    };
+
+    /// Mark the cells of range as dirty
+    void markDirty(const ItemRange& range)
+    {
+      if (!range.inside)
+        return;
+
+      for(int z=range.lo[2]; z <= range.hi[2]; z++) {
+        for(int y=range.lo[1]; y <= range.hi[1]; y++) {
+          for(int x=range.lo[0]; x <= range.hi[0]; x++)
+            m_dirty.push_back(computeCellKey(x, y, z));
+        }
+      }
+    }
+
+    /// Set the cells of item to the ones bound overlaps and mark them as dirty
+    void setItemRange(ItemHandle item, const osg::BoundingBox& bound)
+    {
+      ItemRange& range = m_ranges[item];
+      range.tracked = true;
+      range.inside = bound.valid() && calcCellRange(bound._min, bound._max, range.lo, range.hi);
+      if (!range.moved) {
+        range.moved = true;
+        m_moved.push_back(item);
+      }
+      markDirty(range);
+    }
+
+    /// Move the cells to the start of the item array, dropping the stale items
+    void compact();
+
+    /// A cell key and the index of an item in it, as generated by build()
+    struct KeyedItem {
+      CellKey key;
+      unsigned int index;
+    };
+
+    /*!
+      Generates the KeyedItems of the items [begin,end) for build(). Without output it calculates the cells of
+      the items and counts them, with output it writes them starting at output.
+    */
+    class BuildWorker : public OpenThreads::Thread {
+    public:
+      BuildWorker(HashedGrid *grid, const std::vector<osg::BoundingBox> *bounds, unsigned int begin, unsigned int end, 
+        KeyedItem *output) : m_grid(grid), m_bounds(bounds), m_begin(begin), m_end(end), m_output(output), m_count(0) {}
+
+      virtual void run();
+
+      /// Number of KeyedItems generated
+      unsigned int getCount() const { return m_count; }
+
+    private:
+      HashedGrid *m_grid;
+      const std::vector<osg::BoundingBox> *m_bounds;
+      unsigned int m_begin, m_end;
+      KeyedItem *m_output;
+      unsigned int m_count;
+    };
+
+    /// Run the workers, on threads if there are more than one
+    static void runBuildWorkers(std::vector<BuildWorker *>& workers);
+
+    /// Sort items by key with a least significant digit radix sort, 10 bits at a time
+    static void radixSort(std::vector<KeyedItem>& items, CellKey max_key);
+
+    typedef std::pair<CellKey, T> StagedItem;
+
     osg::Vec3 m_dimension;
+    unsigned int m_hash_size;
     osg::Vec3 m_center;
+
+    /// Inserted since the last finalize(), as (cell key, item)
+    std::vector<StagedItem> m_staged;
+
+    std::vector<Slot> m_slots;
+    std::vector<T> m_items;
+
+    /// For each entry in m_items, the index of the item in m_unique
+    std::vector<unsigned int> m_item_ids;
+
+    /// The distinct items, query() stamps an item by its index here
+    std::vector<T> m_unique;
+
+    /// For each item in m_unique, the cells it overlaps
+    std::vector<ItemRange> m_ranges;
+
+    /// Cells touched since the last update(), can contain duplicates
+    std::vector<CellKey> m_dirty;
+
+    /// Items that changed cells since the last update()
+    std::vector<ItemHandle> m_moved;
+
+    unsigned int m_num_cells;
+
+    /// Number of items in m_items that no cell refers to any more
+    unsigned int m_num_stale_items;
   };
 
   template <class T>  
-  inline void HashedGrid<T>::insert(const osg::Vec3& p, T data)
+  inline bool HashedGrid<T>::insert(const osg::Vec3& p, T data)
   {
     int x,y,z;
     calcCell(p,x,y,z);
+    if (!isValidCell(x,y,z))
+      return false;
 
-    unsigned long idx = computeHashBucketIndex(x,y,z);
-    iterator it = m_hash_vector.find(idx);
-    
-    if (it == m_hash_vector.end()) {
-      HashedDataVector *v = new HashedDataVector;
-      v->insert(data);
-      m_hash_vector.insert(std::make_pair(idx, v));
+    m_staged.push_back(StagedItem(computeCellKey(x,y,z), data));
+    return true;
+  }
+
+  template <class T>  
+  void HashedGrid<T>::finalize()
+  {
+    if (m_staged.empty())
+      return;
+
+    update();
+
+    // Merge with what is already in the table
+    for(unsigned int s=0; s < m_slots.size(); s++) {
+      const Slot& slot = m_slots[s];
+      for(unsigned int i=slot.begin; i < slot.begin+slot.count; i++)
+        m_staged.push_back(StagedItem(slot.key, m_items[i]));
+    }
+
+    // Group by cell, an item is only stored once per cell
+    std::sort(m_staged.begin(), m_staged.end());
+    m_staged.erase(std::unique(m_staged.begin(), m_staged.end()), m_staged.end());
+
+    unsigned int num_cells = 0;
+    for(unsigned int i=0; i < m_staged.size(); i++) {
+      if (i == 0 || m_staged[i].first != m_staged[i-1].first)
+        num_cells++;
     }
-    else
-      it->second->insert(data);
 
-    //std::cerr << "Added: " << idx << ": " << x << ", " << y << ", " << z << std::endl;
+    allocateTable(num_cells);
+    m_items.clear();
+    m_items.reserve(m_staged.size());
+
+    for(unsigned int i=0; i < m_staged.size(); ) {
+      CellKey key = m_staged[i].first;
+      unsigned int begin = m_items.size();
+      for(; i < m_staged.size() && m_staged[i].first == key; i++)
+        m_items.push_back(m_staged[i].second);
+
+      addSlot(key, begin, m_items.size()-begin);
+    }
+
+    // Number the distinct items, query() stamps them by this id
+    m_unique = m_items;
+    std::sort(m_unique.begin(), m_unique.end());
+    m_unique.erase(std::unique(m_unique.begin(), m_unique.end()), m_unique.end());
+
+    m_item_ids.resize(m_items.size());
+    for(unsigned int i=0; i < m_items.size(); i++)
+      m_item_ids[i] = std::lower_bound(m_unique.begin(), m_unique.end(), m_items[i]) - m_unique.begin();
+
+    // The items are renumbered, their cells are no longer tracked
+    m_ranges.assign(m_unique.size(), ItemRange());
+    m_num_stale_items = 0;
+
+    // Release the staging memory
+    std::vector<StagedItem>().swap(m_staged);
   }
 
+  template <class T>  
+  void HashedGrid<T>::build(const std::vector<osg::BoundingBox>& bounds, const std::vector<T>& items, unsigned int num_threads)
+  {
+    clear();
+
+    unsigned int n = osg::minimum(bounds.size(), items.size());
+    if (n == 0)
+      return;
+
+    m_ranges.resize(n);
+    if (num_threads == 0)
+      num_threads = OpenThreads::GetNumberOfProcessors();
+
+    // Starting threads does not pay off for small meshes
+    num_threads = osg::maximum(1u, osg::minimum(num_threads, n/10000));
+
+    // Calculate and count the cells of each range of items
+    std::vector<BuildWorker *> workers(num_threads);
+    for(unsigned int t=0; t < num_threads; t++)
+      workers[t] = new BuildWorker(this, &bounds, n*t/num_threads, n*(t+1)/num_threads, 0L);
+    runBuildWorkers(workers);
+
+    std::vector<unsigned int> offsets(num_threads+1, 0);
+    for(unsigned int t=0; t < num_threads; t++) {
+      offsets[t+1] = offsets[t]+workers[t]->getCount();
+      delete workers[t];
+    }
+
+    std::vector<KeyedItem> keyed(offsets[num_threads]);
+    if (keyed.empty())
+      return;
+
+    // Then let each range write its keys at its offset
+    for(unsigned int t=0; t < num_threads; t++)
+      workers[t] = new BuildWorker(this, &bounds, n*t/num_threads, n*(t+1)/num_threads, &keyed[0]+offsets[t]);
+    runBuildWorkers(workers);
+    for(unsigned int t=0; t < num_threads; t++)
+      delete workers[t];
+
+    radixSort(keyed, computeCellKey(m_hash_size-1, m_hash_size-1, m_hash_size-1));
+
+    unsigned int num_cells = 0;
+    for(unsigned int i=0; i < keyed.size(); i++) {
+      if (i == 0 || keyed[i].key != keyed[i-1].key)
+        num_cells++;
+    }
+    allocateTable(num_cells);
+
+    // An item is generated once per cell, so no deduplication is needed and items are numbered by their index
+    m_unique.assign(items.begin(), items.begin()+n);
+    m_items.reserve(keyed.size());
+    m_item_ids.resize(keyed.size());
+
+    for(unsigned int i=0; i < keyed.size(); ) {
+      CellKey key = keyed[i].key;
+      unsigned int begin = i;
+      for(; i < keyed.size() && keyed[i].key == key; i++) {
+        m_items.push_back(items[keyed[i].index]);
+        m_item_ids[i] = keyed[i].index;
+      }
+
+      addSlot(key, begin, i-begin);
+    }
+  }
+
+  template <class T>  
+  typename HashedGrid<T>::ItemHandle HashedGrid<T>::add(const osg::BoundingBox& bound, T data)
+  {
+    ItemHandle item = m_unique.size();
+    m_unique.push_back(data);
+    m_ranges.push_back(ItemRange());
+    setItemRange(item, bound);
+    return item;
+  }
 
   template <class T>  
-    inline unsigned long HashedGrid<T>::computeHashBucketIndex (
-      const  int & x, 
-      const  int & y, 
-      const  int & z) const
-    {
-      const unsigned int l= m_hash_size*m_hash_size*m_hash_size;
-      const unsigned long  h1 = 0x8da6b343; //Large primes
-      const unsigned long h2  = 0xd8163841;
-      const unsigned long h3  = 0xcb1ab31f;
-      unsigned long n = h1*x + h2*y + h3*z;
-      n = n%l;
-      if (n<0) n+=l;
-      return n;
+  bool HashedGrid<T>::move(ItemHandle item, const osg::BoundingBox& bound)
+  {
+    if (item >= m_ranges.size() || !m_ranges[item].tracked)
+      return false;
+
+    markDirty(m_ranges[item]);
+    setItemRange(item, bound);
+    return true;
+  }
+
+  template <class T>  
+  bool HashedGrid<T>::remove(ItemHandle item)
+  {
+    if (item >= m_ranges.size() || !m_ranges[item].tracked)
+      return false;
+
+    // An empty box has no cells, the item is dropped from its old cells by update()
+    markDirty(m_ranges[item]);
+    setItemRange(item, osg::BoundingBox());
+
+    // Only release the item, the handle is not reused
+    m_unique[item] = T();
+    return true;
+  }
+
+  template <class T>  
+  void HashedGrid<T>::update()
+  {
+    if (m_dirty.empty()) {
+      m_moved.clear();
+      return;
+    }
+
+    std::sort(m_dirty.begin(), m_dirty.end());
+    m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end()), m_dirty.end());
+
+    // The cells the moved items overlap now, sorted like the dirty cells
+    std::vector<KeyedItem> moved_in;
+    for(unsigned int i=0; i < m_moved.size(); i++) {
+      const ItemRange& range = m_ranges[m_moved[i]];
+      if (!range.inside)
+        continue;
+
+      for(int z=range.lo[2]; z <= range.hi[2]; z++) {
+        for(int y=range.lo[1]; y <= range.hi[1]; y++) {
+          for(int x=range.lo[0]; x <= range.hi[0]; x++) {
+            KeyedItem keyed;
+            keyed.key = computeCellKey(x, y, z);
+            keyed.index = m_moved[i];
+            moved_in.push_back(keyed);
+          }
+        }
+      }
+    }
+    radixSort(moved_in, computeCellKey(m_hash_size-1, m_hash_size-1, m_hash_size-1));
+
+    if (m_slots.empty())
+      allocateTable(0);
+
+    // Append the new content of each dirty cell to the item array: the items that stayed plus the ones moved in
+    unsigned int m = 0;
+    for(unsigned int d=0; d < m_dirty.size(); d++) {
+      CellKey key = m_dirty[d];
+      unsigned int begin = m_items.size();
+
+      int s = findSlotIndex(key);
+      if (s >= 0) {
+        int x = compactBits(key), y = compactBits(key >> 1), z = compactBits(key >> 2);
+        unsigned int end = m_slots[s].begin+m_slots[s].count;
+        for(unsigned int i=m_slots[s].begin; i < end; i++) {
+          unsigned int id = m_item_ids[i];
+          if (!m_ranges[id].moved && m_ranges[id].contains(x, y, z)) {
+            T data = m_items[i];
+            m_items.push_back(data);
+            m_item_ids.push_back(id);
+          }
+        }
+        m_num_stale_items += m_slots[s].count;
+      }
+
+      for(; m < moved_in.size() && moved_in[m].key == key; m++) {
+        m_items.push_back(m_unique[moved_in[m].index]);
+        m_item_ids.push_back(moved_in[m].index);
+      }
+
+      unsigned int count = m_items.size()-begin;
+      if (s >= 0 && count) {
+        m_slots[s].begin = begin;
+        m_slots[s].count = count;
+      }
+      else if (s >= 0) {
+        removeSlot(s);
+        m_num_cells--;
+      }
+      else if (count) {
+        if (2*(m_num_cells+1) > m_slots.size())
+          resizeTable(m_num_cells+1);
+        addSlot(key, begin, count);
+        m_num_cells++;
+      }
+    }
+
+    for(unsigned int i=0; i < m_moved.size(); i++)
+      m_ranges[m_moved[i]].moved = false;
+    m_moved.clear();
+    m_dirty.clear();
+
+    if (m_num_stale_items > m_items.size()/2)
+      compact();
+  }
+
+  template <class T>  
+  void HashedGrid<T>::compact()
+  {
+    std::vector<T> items;
+    std::vector<unsigned int> item_ids;
+    items.reserve(m_items.size()-m_num_stale_items);
+    item_ids.reserve(m_items.size()-m_num_stale_items);
+
+    for(unsigned int s=0; s < m_slots.size(); s++) {
+      Slot& slot = m_slots[s];
+      if (!slot.count)
+        continue;
+
+      unsigned int begin = items.size();
+      items.insert(items.end(), m_items.begin()+slot.begin, m_items.begin()+slot.begin+slot.count);
+      item_ids.insert(item_ids.end(), m_item_ids.begin()+slot.begin, m_item_ids.begin()+slot.begin+slot.count);
+      slot.begin = begin;
+    }
+
+    m_items.swap(items);
+    m_item_ids.swap(item_ids);
+    m_num_stale_items = 0;
+  }
+
+  template <class T>  
+  void HashedGrid<T>::BuildWorker::run()
+  {
+    m_count = 0;
+    for(unsigned int i=m_begin; i < m_end; i++) {
+      ItemRange& range = m_grid->m_ranges[i];
+      if (!m_output) {
+        const osg::BoundingBox& box = (*m_bounds)[i];
+        range.tracked = true;
+        range.inside = box.valid() && m_grid->calcCellRange(box._min, box._max, range.lo, range.hi);
+        if (range.inside)
+          m_count += (range.hi[0]-range.lo[0]+1)*(range.hi[1]-range.lo[1]+1)*(range.hi[2]-range.lo[2]+1);
+        continue;
+      }
+
+      if (!range.inside)
+        continue;
+
+      for(int z=range.lo[2]; z <= range.hi[2]; z++) {
+        for(int y=range.lo[1]; y <= range.hi[1]; y++) {
+          for(int x=range.lo[0]; x <= range.hi[0]; x++) {
+            KeyedItem& item = m_output[m_count++];
+            item.key = computeCellKey(x, y, z);
+            item.index = i;
+          }
+        }
+      }
     }
+  }
+
+  template <class T>  
+  void HashedGrid<T>::runBuildWorkers(std::vector<BuildWorker *>& workers)
+  {
+    if (workers.size() == 1) {
+      workers[0]->run();
+      return;
+    }
+
+    for(unsigned int t=0; t < workers.size(); t++)
+      workers[t]->start();
+    for(unsigned int t=0; t < workers.size(); t++)
+      workers[t]->join();
+  }
+
+  template <class T>  
+  void HashedGrid<T>::radixSort(std::vector<KeyedItem>& items, CellKey max_key)
+  {
+    std::vector<KeyedItem> sorted(items.size());
+    std::vector<unsigned int> offsets(1025);
+    for(unsigned int shift=0; shift < 32 && (max_key >> shift) != 0; shift += 10) {
+      std::fill(offsets.begin(), offsets.end(), 0);
+      for(unsigned int i=0; i < items.size(); i++)
+        offsets[((items[i].key >> shift) & 1023)+1]++;
+      for(unsigned int b=1; b < offsets.size(); b++)
+        offsets[b] += offsets[b-1];
+
+      // Stable, so the digits sorted by earlier passes keep their order
+      for(unsigned int i=0; i < items.size(); i++)
+        sorted[offsets[(items[i].key >> shift) & 1023]++] = items[i];
+      items.swap(sorted);
+    }
+  }
+
+  template <class T>  
+  unsigned int HashedGrid<T>::queryCells(const osg::Vec3& min, const osg::Vec3& max, const osg::Vec3 *center, float radius, 
+    QueryResult& result) const
+  {
+    result.m_items.clear();
+    if (result.m_stamps.size() < m_unique.size())
+      result.m_stamps.resize(m_unique.size(), 0);
+
+    // Start a new epoch, all stamps from earlier queries are now stale
+    if (++result.m_epoch == 0) {
+      std::fill(result.m_stamps.begin(), result.m_stamps.end(), 0);
+      result.m_epoch = 1;
+    }
+
+    if (m_slots.empty() || min[0] > max[0] || min[1] > max[1] || min[2] > max[2])
+      return 0;
+
+    int lo[3], hi[3];
+    if (!calcCellRange(min, max, lo, hi))
+      return 0;
+
+    double num_range_cells = 1;
+    for(unsigned int a=0; a < 3; a++)
+      num_range_cells *= hi[a]-lo[a]+1;
+
+    if (num_range_cells > m_num_cells) {
+      // More cells in the range than non empty cells in the grid, scan the table instead
+      for(unsigned int s=0; s < m_slots.size(); s++) {
+        const Slot& slot = m_slots[s];
+        if (!slot.count)
+          continue;
+
+        int x = compactBits(slot.key), y = compactBits(slot.key >> 1), z = compactBits(slot.key >> 2);
+        if (x < lo[0] || x > hi[0] || y < lo[1] || y > hi[1] || z < lo[2] || z > hi[2])
+          continue;
+        if (center && !cellIntersectsSphere(x, y, z, *center, radius))
+          continue;
+
+        addItems(slot, result);
+      }
+      return result.m_items.size();
+    }
+
+    for(int z=lo[2]; z <= hi[2]; z++) {
+      for(int y=lo[1]; y <= hi[1]; y++) {
+        for(int x=lo[0]; x <= hi[0]; x++) {
+          if (center && !cellIntersectsSphere(x, y, z, *center, radius))
+            continue;
+
+          const Slot *slot = findSlot(computeCellKey(x, y, z));
+          if (slot)
+            addItems(*slot, result);
+        }
+      }
+    }
+
+    return result.m_items.size();
+  }
   
 }
 
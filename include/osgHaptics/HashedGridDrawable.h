@@ -6,6 +6,8 @@
 #include <osg/observer_ptr>
 #include "osgHaptics/HashedGrid.h"
 #include "osgHaptics/HapticDevice.h"
+#include "osgHaptics/TriangleInstances.h"
+#include "osgHaptics/TriangleCache.h"
 #include <osgHaptics/export.h>
   
 namespace osgHaptics {
@@ -17,8 +19,11 @@ namespace osgHaptics {
 /*!
   This class will store a HashGrid of Triangles.
   For each draw, a proximity test will be done with the current position of 
-  the haptic proxy.
+  the haptic proxy, swept along its velocity over the look ahead time.
   Only the triangles within the proximity of the proxy will be rendered using pure Immediate OpenGL
+  Instead of copies of the triangles, the grid can store references to the shared triangles of TriangleInstances,
+  see setInstanceHashGrid().
+  The triangles of a TriangleCache are queried through its hierarchy, see setTriangleCache().
 */
 class OSGHAPTICS_EXPORT HashedGridDrawable : public osg::Drawable {
 public:
@@ -31,18 +36,45 @@ public:
 
   typedef HashedGrid< osg::ref_ptr<Triangle> > TriangleHashGrid;
 
+  /// A grid of references to the triangles of a TriangleInstances
+  typedef HashedGrid<TriangleInstances::TriangleRef> InstanceHashGrid;
+
 public:
 
   /// Basic constructor
   HashedGridDrawable(TriangleHashGrid *grid=0L, HapticDevice *device=0L);
 
+  /// Constructor for a grid of references to the triangles of instances
+  HashedGridDrawable(InstanceHashGrid *grid, TriangleInstances *instances, HapticDevice *device=0L);
+
   HashedGridDrawable(const HashedGridDrawable& drawable, 
-    const osg::CopyOp& copyop=osg::CopyOp::SHALLOW_COPY) : osg::Drawable(drawable, copyop) {};
+    const osg::CopyOp& copyop=osg::CopyOp::SHALLOW_COPY) : osg::Drawable(drawable, copyop),
+    m_query_radius(drawable.m_query_radius), m_look_ahead(drawable.m_look_ahead), m_number_of_drawn_triangles(0) {};
 
   META_Object(osg,HashedGridDrawable);
 
   /// Set the HashGrid ot triangles that will be used for intersection test and rendering
   void setHashGrid(TriangleHashGrid *grid) { m_hashed_grid = grid; dirtyBound(); }
+
+  /// Set a grid of references to the triangles of instances to be used instead of the HashGrid of triangles
+  void setInstanceHashGrid(InstanceHashGrid *grid, TriangleInstances *instances) 
+  { 
+    m_instance_grid = grid; 
+    m_instances = instances; 
+    dirtyBound(); 
+  }
+
+  /// Set a cache whose hierarchy is queried instead of a grid. Without a query radius, 1/32 of the size of the cache is used.
+  void setTriangleCache(TriangleCache *cache) { m_cache = cache; dirtyBound(); }
+  TriangleCache *getTriangleCache() { return m_cache.get(); }
+
+  /// Set the radius around the proxy where triangles are rendered, 0 (default) means one cell of the grid
+  void setQueryRadius(float radius) { m_query_radius = radius; }
+  float getQueryRadius() const { return m_query_radius; }
+
+  /// Set the time (s) the proxy is extrapolated along its velocity, the query covers the whole sweep. Default 0.
+  void setLookAhead(float seconds) { m_look_ahead = seconds; }
+  float getLookAhead() const { return m_look_ahead; }
     
   void drawImplementation(osg::RenderInfo& state) const;
 
@@ -56,8 +88,17 @@ protected:
 
 private:
   osg::ref_ptr<TriangleHashGrid> m_hashed_grid;
+  osg::ref_ptr<InstanceHashGrid> m_instance_grid;
+  osg::ref_ptr<TriangleInstances> m_instances;
+  osg::ref_ptr<TriangleCache> m_cache;
 
   osg::observer_ptr<HapticDevice> m_haptic_device;
+  float m_query_radius, m_look_ahead;
+
+  /// Reused between draws so that the query does not allocate
+  mutable TriangleHashGrid::QueryResult m_query_result;
+  mutable InstanceHashGrid::QueryResult m_instance_query_result;
+  mutable TriangleCache::Hierarchy::QueryResult m_cache_query_result;
   mutable unsigned int m_number_of_drawn_triangles;
 };
 
@@ -0,0 +1,65 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_LocalForceModel_h__
+#define __osgHaptics_LocalForceModel_h__
+
+#include <osg/Vec3d>
+
+
+namespace osgHaptics {
+
+  /*!
+    First order approximation of a force field around the position where it was evaluated:
+    F(p) = force + jacobian*(p - position)
+    Computed at a low rate by ForceOperator::calculateForceModel() and extrapolated by the servo loop at every tick.
+    All vectors are in device workspace coordinates.
+  */
+  struct LocalForceModel {
+    LocalForceModel() : valid(false)
+    {
+      for(unsigned int i=0; i < 9; i++)
+        jacobian[i] = 0;
+    }
+
+    /// Return the force at p
+    osg::Vec3d getForce(const osg::Vec3d& p) const
+    {
+      if (!valid)
+        return osg::Vec3d(0,0,0);
+
+      osg::Vec3d d = p - position;
+      return force + osg::Vec3d(
+        jacobian[0]*d.x() + jacobian[1]*d.y() + jacobian[2]*d.z(),
+        jacobian[3]*d.x() + jacobian[4]*d.y() + jacobian[5]*d.z(),
+        jacobian[6]*d.x() + jacobian[7]*d.y() + jacobian[8]*d.z());
+    }
+
+    osg::Vec3d position;  // Where the model was evaluated
+    osg::Vec3d force;     // Force at position
+    osg::Vec3d torque;    // Held constant until the next evaluation
+    double jacobian[9];   // Row major dF/dp, the negated stiffness matrix
+    bool valid;           // False until the first evaluation
+  };
+
+} // namespace osgHaptics
+
+#endif
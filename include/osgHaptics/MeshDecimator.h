@@ -0,0 +1,69 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_MeshDecimator_h__
+#define __osgHaptics_MeshDecimator_h__
+
+#include <osgHaptics/export.h>
+#include <osg/Vec3>
+#include <vector>
+
+
+namespace osgHaptics {
+
+/// Simplifies triangle meshes by quadric error edge collapse.
+
+/*!
+  The triangles are welded at equal vertex positions. Edges are then collapsed, the cheapest first,
+  where the cost of moving a vertex is its summed squared distance to the planes of the triangles it
+  was part of in the original mesh (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics").
+  Collapses that would flip a triangle or pinch the surface are skipped, and open boundaries are kept
+  in place by extra planes perpendicular to the boundary triangles, see setBoundaryWeight().
+  
+  Used by TriangleSet to build the simplified levels that are sent to HL for surfaces far from the proxy.
+*/
+class OSGHAPTICS_EXPORT MeshDecimator
+{
+public:
+  MeshDecimator();
+
+  /// Set how strongly open boundaries are kept in place, 0 lets them move freely. Default 1000.
+  void setBoundaryWeight(float weight) { m_boundary_weight = weight; }
+  float getBoundaryWeight() const { return m_boundary_weight; }
+
+  /*!
+    Simplify a triangle mesh.
+    \param vertices - Three vertices per triangle
+    \param num_triangles - The number of triangles to reduce to. Fewer collapses are made when they
+      would damage the surface, so the result can have more triangles.
+    \param result - Cleared and filled with three vertices per remaining triangle
+    \return the number of triangles in result
+  */
+  unsigned int decimate(const std::vector<osg::Vec3>& vertices, unsigned int num_triangles, 
+    std::vector<osg::Vec3>& result) const;
+
+private:
+  float m_boundary_weight;
+};
+
+} // namespace osgHaptics
+
+#endif
@@ -0,0 +1,86 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ParameterBuffer_h__
+#define __osgHaptics_ParameterBuffer_h__
+
+#include <OpenThreads/Atomic>
+
+
+namespace osgHaptics {
+
+  /// Wait free exchange of a complete set of parameters between the application and the servo thread.
+
+  /*!
+    A triple buffer: the writer fills in a complete set of parameters with write(), the reader gets the
+    most recently written set with read(). Neither side ever blocks, and the reader never sees a half
+    written set.
+    There can only be one reader (the servo thread). Several application threads can call write() as long
+    as they serialize these calls among themselves.
+  */
+  template<class T>
+  class ParameterBuffer {
+  public:
+
+    /// Constructor, all three buffers will be initialized to value
+    ParameterBuffer(const T& value=T()) : m_state(1), m_back(0), m_front(2)
+    {
+      m_buffers[0] = m_buffers[1] = m_buffers[2] = value;
+    }
+
+    /// Publish a new set of parameters (writer side)
+    void write(const T& value)
+    {
+      m_buffers[m_back] = value;
+
+      // Swap our back buffer with the middle one and flag that new data is available
+      unsigned int previous = m_state.exchange(m_back | NEW_DATA);
+      m_back = previous & INDEX_MASK;
+    }
+
+    /// Return the most recently published set of parameters (reader side)
+    const T& read()
+    {
+      if (m_state & NEW_DATA) {
+        unsigned int previous = m_state.exchange(m_front);
+        m_front = previous & INDEX_MASK;
+      }
+      return m_buffers[m_front];
+    }
+
+  private:
+    enum { INDEX_MASK = 0x3, NEW_DATA = 0x4 };
+
+    /// Index of the middle buffer and the NEW_DATA flag
+    OpenThreads::Atomic m_state;
+
+    unsigned int m_back;  // Only touched by the writer
+    unsigned int m_front; // Only touched by the reader
+    T m_buffers[3];
+
+    // Not copyable
+    ParameterBuffer(const ParameterBuffer&);
+    ParameterBuffer& operator=(const ParameterBuffer&);
+  };
+
+} // namespace osgHaptics
+
+#endif
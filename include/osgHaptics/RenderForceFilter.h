@@ -0,0 +1,111 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_RenderForceFilter_h__
+#define __osgHaptics_RenderForceFilter_h__
+
+#include <osgHaptics/ForceOperator.h>
+#include <osgHaptics/export.h>
+#include <osg/Vec3d>
+
+#include <vector>
+
+
+namespace osgHaptics {
+
+  /// Brings a force set by the application at the graphics rate up to the servo rate.
+
+  /*!
+    Created by the HapticDevice, which adds it to its servo loop with the first HapticDevice::setRenderForce().
+    Each tick the force is interpolated between the two latest samples (LINEAR/CUBICAL_INTERPOLATION), held
+    (NO_INTERPOLATION) or interpolated and run through a windowed FIR lowpass filter (FILTER_INTERPOLATION).
+    The filter history is a fixed size circular buffer, nothing is allocated in the servo thread.
+    Forces are given in world coordinates.
+  */
+  class OSGHAPTICS_EXPORT RenderForceFilter : public ForceOperator {
+  public:
+
+    /// Maximum number of filter coefficients
+    enum { MAX_TAPS = 100 };
+
+    enum Mode { 
+      HOLD, 
+      LINEAR, 
+      CUBICAL, 
+      FILTER 
+    };
+
+    RenderForceFilter();
+
+    /// Add a new sample of the force, time is in HapticDevice::getTimeStamp() seconds
+    void addSample(const osg::Vec3d& force, double time);
+
+    /// Set the interpolation mode and the FIR coefficients used in FILTER mode (at most MAX_TAPS are used)
+    void setMode(Mode mode, const std::vector<double>& coefficients);
+
+    using ForceOperator::calculateForce;
+    using ForceOperator::calculateTorque;
+
+    virtual void calculateForce( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out );
+    virtual void calculateTorque( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out ) { out.set(0,0,0); }
+
+  protected:
+    virtual ~RenderForceFilter() {}
+
+  private:
+    struct Sample {
+      Sample() : time(0), serial(0) {}
+      osg::Vec3d force;
+      double time;
+      unsigned int serial;
+    };
+
+    struct Parameters {
+      Parameters() : mode(LINEAR), num_taps(0) {}
+      Mode mode;
+      unsigned int num_taps;
+      double taps[MAX_TAPS];
+    };
+
+    /// Push force into the filter history and return the dot product with the coefficients
+    osg::Vec3d filter(const Parameters& p, const osg::Vec3d& force);
+
+    // Application side, protected by m_mutex
+    Sample m_sample;
+    Parameters m_parameters;
+    ParameterBuffer<Sample> m_sample_buffer;
+    ParameterBuffer<Parameters> m_parameter_buffer;
+
+    // Servo side state
+    Sample m_current, m_previous;
+    unsigned int m_sample_serial;
+
+    /*!
+      Filter history, each sample is written twice (at i and i+MAX_TAPS) so that the last
+      num_taps samples always are contiguous, starting at m_history_pos+MAX_TAPS-num_taps+1.
+    */
+    double m_history_x[2*MAX_TAPS], m_history_y[2*MAX_TAPS], m_history_z[2*MAX_TAPS];
+    unsigned int m_history_pos;
+  };
+
+} // namespace osgHaptics
+
+#endif
@@ -0,0 +1,78 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ServoFrame_h__
+#define __osgHaptics_ServoFrame_h__
+
+#include <osgHaptics/ServoInput.h>
+#include <osg/Matrix>
+#include <osg/Vec3d>
+
+
+namespace osgHaptics {
+
+  /*!
+    The state of one servo tick, built once by the ServoLoop from the ServoInput and passed to every ForceOperator.
+    ForceOperators read the device state from here and never call the HD API, so the cost of a tick
+    does not grow with the number of operators, and an operator can be evaluated with a frame built by hand.
+    Vectors are in device workspace coordinates.
+  */
+  struct ServoFrame {
+    ServoFrame() : time(0), tick(0), buttons(0), input(0L), valid(false) {}
+
+    /// Set the device state from input, the matrices are left untouched
+    void set(const ServoInput& in, unsigned int tick_count)
+    {
+      input = &in;
+      time = in.time;
+      tick = tick_count;
+      transform.set(in.transform);
+      position.set(in.transform[12], in.transform[13], in.transform[14]);
+      velocity.set(in.velocity[0], in.velocity[1], in.velocity[2]);
+      last_velocity.set(in.last_velocity[0], in.last_velocity[1], in.last_velocity[2]);
+      angular_velocity.set(in.angular_velocity[0], in.angular_velocity[1], in.angular_velocity[2]);
+      force.set(in.force[0], in.force[1], in.force[2]);
+      torque.set(in.torque[0], in.torque[1], in.torque[2]);
+      buttons = in.buttons;
+      valid = true;
+    }
+
+    double time;                  // Seconds
+    unsigned int tick;            // ServoLoop::getTickCount() for this tick
+
+    osg::Matrix transform;        // Transformation of the end effector
+    osg::Vec3d position;          // Translation of transform
+    osg::Vec3d velocity;
+    osg::Vec3d last_velocity;
+    osg::Vec3d angular_velocity;
+    osg::Vec3d force, torque;     // Rendered by HL, before the ForceOperators are applied
+    int buttons;
+
+    osg::Matrix world_to_workspace;
+    osg::Matrix workspace_to_world;
+
+    const ServoInput *input;      // The raw values the frame was built from
+    bool valid;                   // False until set() is called, a default frame is not the state of any tick
+  };
+
+} // namespace osgHaptics
+
+#endif
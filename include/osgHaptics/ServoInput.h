@@ -0,0 +1,48 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ServoInput_h__
+#define __osgHaptics_ServoInput_h__
+
+
+namespace osgHaptics {
+
+  /*!
+    Everything the servo loop reads from the haptic device during one tick.
+    It is read from the HD API once at the start of each tick (or from a recorded trace when replaying),
+    ForceOperators should use it instead of calling hdGet*() themselves.
+    All vectors are in device workspace coordinates.
+  */
+  struct ServoInput {
+    double time;                // Seconds, the time used by the ForceOperators for this tick
+    double transform[16];       // HD_CURRENT_TRANSFORM
+    double velocity[3];         // HD_CURRENT_VELOCITY
+    double last_velocity[3];    // HD_LAST_VELOCITY
+    double angular_velocity[3]; // HD_CURRENT_ANGULAR_VELOCITY
+    double force[3];            // HD_CURRENT_FORCE, the force rendered by HL before the ForceOperators are applied
+    double torque[3];           // HD_CURRENT_TORQUE
+    int buttons;                // HD_CURRENT_BUTTONS
+    int pad;
+  };
+
+} // namespace osgHaptics
+
+#endif
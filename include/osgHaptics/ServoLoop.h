@@ -0,0 +1,171 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ServoLoop_h__
+#define __osgHaptics_ServoLoop_h__
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Matrix>
+#include <osg/Vec3d>
+#include <osg/Timer>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Atomic>
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/ForceOperator.h>
+#include <osgHaptics/ServoFrame.h>
+#include <osgHaptics/ServoStatistics.h>
+#include <osgHaptics/ServoTrace.h>
+#include <osgHaptics/ForceModelWorker.h>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+
+
+namespace osgHaptics {
+
+  /// The part of the servo loop that does not depend on the HD API.
+
+  /*!
+    A ServoLoop holds the set of ForceOperators, evaluates them for one tick at a time with tick()
+    and keeps timing statistics and an optional trace of each tick.
+    tick() is called from the servo thread: by the HD scheduler callback of a HapticDevice, or by a ServoReplay
+    feeding recorded ticks. It never blocks and never allocates, all the application side methods
+    hand their changes over to it through atomic pointer swaps.
+  */
+  class OSGHAPTICS_EXPORT ServoLoop : public osg::Referenced {
+  public:
+    ServoLoop();
+
+    /*!
+      Evaluate all enabled ForceOperators for one tick.
+      \param input - The state of the device for this tick, input.force/input.torque is the force rendered before the ForceOperators
+      \param world_to_workspace - The current world to haptic workspace matrix, 0 if not yet known. ForceOperators are only evaluated with a valid matrix.
+      \param force - The resulting force to send to the device
+      \param torque - The resulting torque to send to the device
+    */
+    void tick(const ServoInput& input, const osg::Matrix *world_to_workspace, osg::Vec3d& force, osg::Vec3d& torque);
+
+    /// Add a ForceOperator, the servo loop picks up the new set of ForceOperators at its next tick
+    void addForceOperator(ForceOperator *fo);
+
+    /// Remove a ForceOperator
+    void removeForceOperator(ForceOperator *fo);
+
+    /// Remove all ForceOperators
+    void removeAllForceOperators();
+
+    /// Set the maximum force any single ForceOperator, and the total force, is clamped to. 0 (default) means no clamping.
+    void setMaxForce(double max_force) { m_max_force = max_force; }
+    double getMaxForce() const { return m_max_force; }
+
+    /*!
+      Specify wether anything is calling tick() or not. When nothing calls tick(), retired data can be
+      deallocated right away instead of waiting for the next tick.
+    */
+    void setTicking(bool flag);
+
+    /// Return the number of calls to tick() so far
+    unsigned int getTickCount() const { return m_tick_count; }
+
+    /// Return the timing of the ticks, can be queried from any thread
+    const ServoStatistics& getServoStatistics() const { return m_servo_statistics; }
+
+    /// Clear the statistics, including the cost histograms of the added ForceOperators
+    void resetServoStatistics();
+
+    /// Print p50/p99/max of the tick timing and of each added ForceOperator
+    void printServoStatistics(std::ostream& os);
+
+    /// Start writing a TraceRecord for each tick to filename, see HapticDevice::startTrace()
+    bool startTrace(const std::string& filename, unsigned int buffer_size=16384);
+
+    /// Stop the current trace, write the remaining records and close the file
+    void stopTrace();
+
+    /// Return true if a trace is being recorded
+    bool isTracing() const { return m_trace_writer.get() != 0L; }
+
+  protected:
+    virtual ~ServoLoop();
+
+  private:
+    typedef std::map<ForceOperator *, osg::ref_ptr<ForceOperator> > ForceOperatorMap;
+    ForceOperatorMap m_force_operators;
+    OpenThreads::Mutex m_fo_mutex;
+
+    /*!
+      Immutable copy of m_force_operators read by tick().
+      A new snapshot is published each time the set of ForceOperators changes, the previous one
+      is retired and deleted first when tick() has finished at least once after the swap.
+    */
+    struct ForceOperatorSnapshot : public std::vector< osg::ref_ptr<ForceOperator> > {
+      ForceOperatorSnapshot() : retired_tick(0), multi_rate(false) {}
+      unsigned int retired_tick;
+      bool multi_rate; // true if any of the ForceOperators has an evaluation rate
+    };
+
+    typedef std::vector<ForceOperatorSnapshot *> ForceOperatorSnapshotVector;
+    ForceOperatorSnapshotVector m_retired_fo_snapshots;
+
+    OpenThreads::AtomicPtr m_fo_snapshot;
+
+    /// Publish a new snapshot of m_force_operators to tick(). m_fo_mutex must be held.
+    void publishForceOperators();
+
+    /// Delete retired snapshots that tick() no longer can reference (or all of them). m_fo_mutex must be held.
+    void reclaimForceOperatorSnapshots(bool all=false);
+
+    /// Incremented at the end of each tick(), when it is done with the current snapshot and trace writer
+    OpenThreads::Atomic m_tick_count;
+    OpenThreads::Atomic m_ticking;
+
+    double m_max_force;
+
+    ServoStatistics m_servo_statistics;
+
+    /// Start of the previous tick, only touched by tick()
+    osg::Timer_t m_previous_tick_start;
+
+    /// Passed to the ForceOperators, only touched by tick(). Keeps the inverse of the last world_to_workspace matrix.
+    ServoFrame m_frame;
+
+    /// Evaluates the ForceOperators with an evaluation rate, created with the first one. Protected by m_fo_mutex.
+    ForceModelWorker *m_force_model_worker;
+
+    /// The latest frame, written by tick() for the ForceModelWorker
+    ParameterBuffer<ServoFrame> m_worker_frames;
+
+    /// The ServoTraceWriter tick() pushes TraceRecords to, if any. Owned by the ServoLoop.
+    OpenThreads::AtomicPtr m_trace_writer;
+    OpenThreads::Mutex m_trace_mutex;
+
+    // Not copyable
+    ServoLoop(const ServoLoop&);
+    ServoLoop& operator=(const ServoLoop&);
+  };
+
+} // namespace osgHaptics
+
+#endif
@@ -0,0 +1,71 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ServoReplay_h__
+#define __osgHaptics_ServoReplay_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/ServoLoop.h>
+#include <osgHaptics/ServoTrace.h>
+#include <osg/ref_ptr>
+
+#include <vector>
+#include <string>
+
+
+namespace osgHaptics {
+
+  /*!
+    Replays a trace recorded with HapticDevice::startTrace() through a ServoLoop, without any haptic device.
+    Each recorded tick is fed to ServoLoop::tick() with the recorded device state and world to workspace matrix,
+    as fast as possible. This gives repeatable throughput and latency numbers for a set of ForceOperators,
+    and the replayed forces can be compared with the recorded ones to catch regressions.
+  */
+  class OSGHAPTICS_EXPORT ServoReplay {
+  public:
+
+    /// The ForceOperators to replay are added to loop
+    ServoReplay(ServoLoop *loop);
+
+    /// Read all records of a trace file into memory, so that file I/O is not part of the replay
+    bool open(const std::string& filename);
+
+    /// Return the number of ticks read by open()
+    unsigned int getNumTicks() const { return m_records.size(); }
+
+    /*!
+      Feed all ticks through the ServoLoop, repetitions times.
+      \return the wall clock time of the whole replay in seconds
+    */
+    double run(unsigned int repetitions=1);
+
+    /// Return the largest difference between a replayed and the recorded force during the last run()
+    double getMaxForceDeviation() const { return m_max_force_deviation; }
+
+  private:
+    osg::ref_ptr<ServoLoop> m_servo_loop;
+    std::vector<TraceRecord> m_records;
+    double m_max_force_deviation;
+  };
+
+} // namespace osgHaptics
+
+#endif
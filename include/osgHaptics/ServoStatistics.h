@@ -0,0 +1,138 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ServoStatistics_h__
+#define __osgHaptics_ServoStatistics_h__
+
+#include <osgHaptics/export.h>
+#include <OpenThreads/Atomic>
+#include <iostream>
+#include <string>
+
+
+namespace osgHaptics {
+
+  /// Fixed size histogram of durations, recorded from the servo thread without locking or allocation.
+
+  /*!
+    Durations are recorded in nanoseconds into log-linear bins: 16 bins for each power of two,
+    which gives a relative error below 1/16 (6%) for any value up to ~4 seconds.
+    Each histogram has a single writer (the servo thread). It can be read from any thread at any time,
+    a read that happens concurrently with record() might miss the sample being recorded.
+  */
+  class OSGHAPTICS_EXPORT TimingHistogram {
+  public:
+    TimingHistogram() {}
+
+    /// Record a duration in nanoseconds (servo thread)
+    inline void record(unsigned int nanoseconds);
+
+    /// Return the number of recorded samples
+    unsigned int getCount() const { return m_count; }
+
+    /// Return the duration (in microseconds) that fraction p (0..1) of the samples are below, 0.5 gives the median.
+    double getPercentile(double p) const;
+
+    /// Return the largest recorded duration in microseconds
+    double getMax() const { return unsigned(m_max)*0.001; }
+
+    /// Clear all recorded samples. Samples recorded at the same time as the reset might be lost.
+    void reset();
+
+    /// Write count, p50, p99 and max to os as a single line
+    void print(std::ostream& os, const std::string& name) const;
+
+  private:
+    enum { 
+      SUB_BITS = 4, 
+      SUB_BINS = 1 << SUB_BITS, 
+      NUM_BINS = SUB_BINS + (32-SUB_BITS)*SUB_BINS 
+    };
+
+    static unsigned int binIndex(unsigned int value);
+
+    /// Return the largest value (in nanoseconds) that is stored in bin i
+    static double binUpperBound(unsigned int i);
+
+    OpenThreads::Atomic m_bins[NUM_BINS];
+    OpenThreads::Atomic m_count;
+    OpenThreads::Atomic m_max;
+
+    // Not copyable
+    TimingHistogram(const TimingHistogram&);
+    TimingHistogram& operator=(const TimingHistogram&);
+  };
+
+
+  inline unsigned int TimingHistogram::binIndex(unsigned int value)
+  {
+    if (value < SUB_BINS)
+      return value;
+
+    // Position of the most significant bit
+    unsigned int msb = SUB_BITS;
+    while (msb < 31 && (value >> (msb+1)))
+      msb++;
+
+    unsigned int shift = msb-SUB_BITS;
+    return SUB_BINS + shift*SUB_BINS + ((value >> shift) & (SUB_BINS-1));
+  }
+
+  inline void TimingHistogram::record(unsigned int nanoseconds)
+  {
+    ++m_bins[binIndex(nanoseconds)];
+    ++m_count;
+
+    // Only one writer, so there is no need for a compare and swap here
+    if (nanoseconds > unsigned(m_max))
+      m_max.exchange(nanoseconds);
+  }
+
+
+  /// Timing of the servo loop of a HapticDevice
+  class OSGHAPTICS_EXPORT ServoStatistics {
+  public:
+    ServoStatistics() {}
+
+    /// Time spent in each call to the force callback
+    const TimingHistogram& getTickDuration() const { return m_tick_duration; }
+
+    /// Time between the start of two consecutive calls to the force callback, nominally 1000us
+    const TimingHistogram& getTickPeriod() const { return m_tick_period; }
+
+    void reset() { m_tick_duration.reset(); m_tick_period.reset(); }
+
+    void print(std::ostream& os) const;
+
+  private:
+    friend class ServoLoop;
+
+    TimingHistogram m_tick_duration;
+    TimingHistogram m_tick_period;
+
+    // Not copyable
+    ServoStatistics(const ServoStatistics&);
+    ServoStatistics& operator=(const ServoStatistics&);
+  };
+
+} // namespace osgHaptics
+
+#endif
@@ -0,0 +1,151 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_ServoTrace_h__
+#define __osgHaptics_ServoTrace_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/ServoInput.h>
+#include <osgSensor/StopThread.h>
+#include <OpenThreads/Atomic>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+
+namespace osgHaptics {
+
+  /// One tick of the servo loop, stored as is in a trace file. Holds all inputs of the tick, so it can be replayed with ServoReplay.
+  struct TraceRecord {
+    enum Flags { VALID_WORLD_TO_WORKSPACE = 0x1 };
+
+    ServoInput input;             // Everything read from the device this tick
+    double world_to_workspace[16]; // Only valid if flags has VALID_WORLD_TO_WORKSPACE
+    double force[3];              // Force commanded to the device
+    double torque[3];             // Torque commanded to the device
+    unsigned int num_operators;   // Number of ForceOperators that were enabled this tick
+    unsigned int tick;            // Servo tick counter, a gap means records were dropped
+    unsigned int flags;
+    unsigned int pad;
+  };
+
+  /// Header written first in a trace file
+  struct TraceFileHeader {
+    char magic[8];            // "OHTRACE"
+    unsigned int version;
+    unsigned int record_size; // sizeof(TraceRecord) of the writer
+  };
+
+
+  /// Wait free single producer/single consumer queue of TraceRecords with a fixed capacity.
+  class OSGHAPTICS_EXPORT TraceRingBuffer {
+  public:
+
+    /// Capacity will be rounded up to a power of two
+    TraceRingBuffer(unsigned int capacity);
+
+    /// Add a record (producer). Returns false and counts the record as dropped if the buffer is full.
+    bool push(const TraceRecord& record);
+
+    /// Remove the oldest record (consumer). Returns false if the buffer is empty.
+    bool pop(TraceRecord& record);
+
+    /// Return the number of records that did not fit in the buffer
+    unsigned int getNumDropped() const { return m_dropped; }
+
+  private:
+    std::vector<TraceRecord> m_records;
+    unsigned int m_mask;
+
+    OpenThreads::Atomic m_head; // Next slot to write, only incremented by the producer
+    OpenThreads::Atomic m_tail; // Next slot to read, only incremented by the consumer
+    OpenThreads::Atomic m_dropped;
+
+    // Not copyable
+    TraceRingBuffer(const TraceRingBuffer&);
+    TraceRingBuffer& operator=(const TraceRingBuffer&);
+  };
+
+
+  /*!
+    Records TraceRecords from the servo loop into a binary file.
+    The servo thread only copies each record into a TraceRingBuffer, a background thread drains
+    the buffer and does all the file I/O.
+  */
+  class OSGHAPTICS_EXPORT ServoTraceWriter : public vrutils::StopThread {
+  public:
+
+    /// Open the file and start the writer thread. Check isOpen() for failure.
+    ServoTraceWriter(const std::string& filename, unsigned int buffer_size=16384);
+
+    /// Stops the writer thread, writes any remaining records and closes the file
+    virtual ~ServoTraceWriter();
+
+    bool isOpen() const { return m_open; }
+
+    /// Called from the servo thread, never blocks
+    bool push(const TraceRecord& record) { return m_buffer.push(record); }
+
+    /// Stop the thread after writing all queued records
+    void close();
+
+    unsigned int getNumDropped() const { return m_buffer.getNumDropped(); }
+
+  protected:
+    virtual void run();
+
+  private:
+    /// Write all queued records to the file
+    void drain();
+
+    TraceRingBuffer m_buffer;
+    std::ofstream m_file;
+    bool m_open;
+    std::vector<TraceRecord> m_write_buffer;
+  };
+
+
+  /// Reads a trace file written by ServoTraceWriter
+  class OSGHAPTICS_EXPORT ServoTraceReader {
+  public:
+    ServoTraceReader() {}
+
+    /// Open the file and verify the header, returns false if the file is not a valid trace
+    bool open(const std::string& filename);
+
+    /// Read the next record, returns false at the end of the file
+    bool read(TraceRecord& record);
+
+    /// Write the names of the columns written by writeCSV()
+    static void writeCSVHeader(std::ostream& os);
+
+    /// Write a record as a line of comma separated values
+    static void writeCSV(std::ostream& os, const TraceRecord& record);
+
+  private:
+    std::ifstream m_file;
+  };
+
+} // namespace osgHaptics
+
+#endif
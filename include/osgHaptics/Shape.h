@@ -49,6 +49,15 @@
     {
     public :
 
+      /// How the geometry of the shape is captured by HL
+      enum ShapeType {
+        /// Every triangle is captured, exact also for concave and back facing parts
+        FEEDBACK_BUFFER, 
+        /// HL reads back the depth buffer around the proxy, much cheaper for dense, mostly convex meshes
+        DEPTH_BUFFER,
+        /// DEPTH_BUFFER when the drawable has more triangles than the depth buffer threshold
+        AUTOMATIC_SHAPE_TYPE
+      };
 
       /// Default constructor
       explicit Shape(HapticDevice *device, int enabled=1);
@@ -64,6 +73,18 @@
       /// Return if this shape is enabled for haptic rendering
       bool getEnable() const { return m_enabled ? true : false; }
 
+      /*!
+        Set how HL captures the geometry of this shape, FEEDBACK_BUFFER by default.
+        Depth buffer shapes should be used together with HapticDevice::setEnableAdaptiveViewport(), 
+        which prepareHapticCamera() enables.
+      */
+      void setShapeType(ShapeType type) { m_shape_type = type; }
+      ShapeType getShapeType() const { return m_shape_type; }
+
+      /// Set the number of triangles above which AUTOMATIC_SHAPE_TYPE selects a depth buffer shape
+      void setDepthBufferThreshold(unsigned int num_triangles) { m_depth_buffer_threshold = num_triangles; }
+      unsigned int getDepthBufferThreshold() const { return m_depth_buffer_threshold; }
+
 
 	  /// Equality operator
     virtual bool operator ==(HLuint shape_id)  {
@@ -105,6 +126,9 @@
           m_name(trans.m_name),
           m_shape_id(trans.m_shape_id),
           m_enabled(trans.m_enabled),
+          m_shape_type(trans.m_shape_type),
+          m_depth_buffer_threshold(trans.m_depth_buffer_threshold),
+          m_current_shape_type(FEEDBACK_BUFFER),
           m_device(trans.m_device)
           {}
 
@@ -146,6 +170,8 @@
 
         // Compare each parameter in turn against the rhs.
         COMPARE_StateAttribute_Parameter(m_enabled)
+        COMPARE_StateAttribute_Parameter(m_shape_type)
+        COMPARE_StateAttribute_Parameter(m_depth_buffer_threshold)
 
         return 0; // Passed all the above comparison macros, so must be equal.
       }
@@ -162,8 +188,10 @@
       /*!
         Ends the current hl shape
         Should be called just after any drawable is drawn.
+        \param num_triangles - Number of triangles that will be drawn into the shape, 0 if not known.
+        Selects the shape type when it is AUTOMATIC_SHAPE_TYPE, and sizes the feedback buffer of HL.
       */
-      virtual void preDraw() const; 
+      virtual void preDraw(unsigned int num_triangles=0) const; 
 
       virtual bool getModeUsage(ModeUsage& usage) const
       {
@@ -206,6 +234,12 @@
       std::string m_name;
       HLuint m_shape_id;
       int m_enabled;
+      ShapeType m_shape_type;
+      unsigned int m_depth_buffer_threshold;
+
+      /// The type selected by preDraw(), to be ended by postDraw()
+      mutable ShapeType m_current_shape_type;
+
       mutable osg::observer_ptr<HapticDevice> m_device;
       //osg::observe_ptr<osg::Node> m_node;
       osg::observer_ptr<osg::Node> m_node;
@@ -117,7 +117,7 @@
         Ends the current hl shape
         Should be called just after any drawable is drawn.
         */
-        virtual void preDraw() const {}
+        virtual void preDraw(unsigned int num_triangles=0) const {}
 
         void addChild(Shape *shape) { 
           m_children[shape] = shape; 
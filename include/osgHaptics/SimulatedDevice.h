@@ -0,0 +1,186 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_SimulatedDevice_h__
+#define __osgHaptics_SimulatedDevice_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/ServoInput.h>
+#include <osgHaptics/ParameterBuffer.h>
+#include <osgSensor/StopThread.h>
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Vec3d>
+#include <OpenThreads/Mutex>
+
+#include <vector>
+
+
+namespace osgHaptics {
+
+  class HapticDevice;
+
+  /// Software replacement of the HD API and scheduler for a HapticDevice without any hardware.
+
+  /*!
+    A SimulatedDevice is created by a HapticDevice constructed with HapticDevice::SIMULATED_DEVICE.
+    It runs its own servo thread at 1-4 kHz which, instead of hdScheduleAsynchronous(), calls
+    HapticDevice::runServoTick() with the state of a virtual end effector.
+
+    The end effector is a point mass held by a "hand": a spring-damper pulling it towards a position
+    given by a scriptable Trajectory. The force computed by the servo loop is applied to the
+    mass, so ForceOperators push back on the simulated hand as they would on a real user.
+    Units are the same as the HD API: millimeters, Newtons and seconds.
+  */
+  class OSGHAPTICS_EXPORT SimulatedDevice : public osg::Referenced, public vrutils::StopThread {
+  public:
+
+    /// Describes the motion of the simulated hand holding the end effector
+    class OSGHAPTICS_EXPORT Trajectory : public osg::Referenced {
+    public:
+      /// Return the position (in workspace coordinates) of the hand at time (seconds since the scheduler was started)
+      virtual osg::Vec3d getPosition(double time) const = 0;
+
+      /// Return the button mask (bit 0 button 1, bit 1 button 2) at time
+      virtual int getButtons(double time) const { return 0; }
+
+    protected:
+      virtual ~Trajectory() {}
+    };
+
+    /// Keeps the hand at a fixed position
+    class OSGHAPTICS_EXPORT FixedTrajectory : public Trajectory {
+    public:
+      FixedTrajectory(const osg::Vec3d& position=osg::Vec3d(0,0,0)) : m_position(position) {}
+      virtual osg::Vec3d getPosition(double time) const { return m_position; }
+    private:
+      osg::Vec3d m_position;
+    };
+
+    /// Moves the hand in a circle
+    class OSGHAPTICS_EXPORT CircleTrajectory : public Trajectory {
+    public:
+      /// A circle around center in the plane spanned by axis1 and axis2 (both with the length of the radius) with frequency Hz
+      CircleTrajectory(const osg::Vec3d& center, const osg::Vec3d& axis1, const osg::Vec3d& axis2, double frequency) : 
+        m_center(center), m_axis1(axis1), m_axis2(axis2), m_frequency(frequency) {}
+      virtual osg::Vec3d getPosition(double time) const;
+    private:
+      osg::Vec3d m_center, m_axis1, m_axis2;
+      double m_frequency;
+    };
+
+    /// Moves the hand linearly between waypoints, with a button mask for each waypoint
+    class OSGHAPTICS_EXPORT WaypointTrajectory : public Trajectory {
+    public:
+      WaypointTrajectory() : m_loop(false) {}
+
+      /// Add a waypoint, time must be larger than the time of the previous waypoint
+      void addWaypoint(double time, const osg::Vec3d& position, int buttons=0);
+
+      /// If true, the trajectory restarts from the first waypoint after the last one
+      void setLoop(bool flag) { m_loop = flag; }
+
+      virtual osg::Vec3d getPosition(double time) const;
+      virtual int getButtons(double time) const;
+
+    private:
+      struct Waypoint {
+        double time;
+        osg::Vec3d position;
+        int buttons;
+      };
+
+      /// Return the index of the last waypoint before time (after wrapping time if looping)
+      unsigned int findWaypoint(double& time) const;
+
+      std::vector<Waypoint> m_waypoints;
+      bool m_loop;
+    };
+
+    /// The end effector model, read by the servo thread through a ParameterBuffer
+    struct Parameters {
+      Parameters() : mass(0.05), stiffness(0.5), damping(0.005), max_force(3.3) {}
+      double mass;      // Kg
+      double stiffness; // N/mm, of the spring between the hand and the end effector
+      double damping;   // N/(mm/s)
+      double max_force; // N, reported as HD_NOMINAL_MAX_FORCE
+    };
+
+    SimulatedDevice(HapticDevice *device);
+
+    /// Set the rate of the servo thread, clamped to 1000-4000 Hz. Must be called before startScheduler().
+    void setUpdateRate(unsigned int hz);
+    unsigned int getUpdateRate() const { return m_update_rate; }
+
+    void setParameters(const Parameters& parameters);
+    Parameters getParameters() const;
+
+    /*!
+      Set the motion of the simulated hand, a FixedTrajectory at the origin by default.
+      The servo thread might still use the previous trajectory, so all trajectories are kept until the SimulatedDevice is deleted.
+    */
+    void setTrajectory(Trajectory *trajectory);
+
+    /// Start the servo thread, a SimulatedDevice can only be started once
+    void startScheduler();
+
+    /// Stop the servo thread and wait for it to finish
+    void stopScheduler();
+
+    /// Return the most recent state of the end effector and the force applied to it. Can be called from any single application thread.
+    void getState(ServoInput& state, osg::Vec3d& force, osg::Vec3d& torque);
+
+  protected:
+    virtual ~SimulatedDevice();
+
+    virtual void run();
+
+  private:
+    /// Advance the end effector dt seconds, with force from the servo loop applied
+    void integrate(const Parameters& p, double time, double dt, const osg::Vec3d& force);
+
+    HapticDevice *m_device;
+    unsigned int m_update_rate;
+    bool m_running;
+
+    mutable OpenThreads::Mutex m_mutex;
+    Parameters m_parameters;
+    ParameterBuffer<Parameters> m_parameter_buffer;
+
+    // Published by the application, read by the servo thread
+    OpenThreads::AtomicPtr m_trajectory;
+    std::vector< osg::ref_ptr<Trajectory> > m_trajectories;
+
+    // Owned by the servo thread
+    osg::Vec3d m_position, m_velocity, m_last_velocity;
+    int m_buttons;
+
+    struct State {
+      ServoInput input;
+      osg::Vec3d force, torque;
+    };
+    ParameterBuffer<State> m_state_buffer;
+  };
+
+} // namespace osgHaptics
+
+#endif
@@ -60,29 +60,32 @@
       */
       virtual void setEnable(bool flag, double fade_ms);
 
-      /// Return the current position of the anchor (the interpolated one)
+      /// Return the position of the anchor last specified with setPosition()
       osg::Vec3d getPosition() const {   
         OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-        osg::Vec3d pos = m_current_position;
+        osg::Vec3d pos = m_parameters.target_position;
         return pos; 
       }
 
       void setStiffness( double stiffness );
       double getStiffness() const {   
         OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-        double s = m_stiffness;
+        double s = m_parameters.stiffness;
         return s; 
       }
 
       void setDamping( double damping );
       double getDamping() const {   
         OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-        double s = m_damping;
+        double s = m_parameters.damping;
         return s; 
       }
 
-      virtual void calculateForce( const osg::Vec3d& in, osg::Vec3d& out, double time );
-      virtual void calculateTorque( const osg::Vec3d& in, osg::Vec3d& out, double time ) { out = in; }
+      using ForceOperator::calculateForce;
+      using ForceOperator::calculateTorque;
+
+      virtual void calculateForce( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out );
+      virtual void calculateTorque( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out ) { out = in; }
 
     protected:
 
@@ -90,18 +93,39 @@
       virtual ~SpringForceOperator() {}
 
     private:
-      double m_stiffness;
-      double m_damping;
+
+      /// Everything the servo thread needs from the application, published as one set
+      struct Parameters {
+        Parameters() : stiffness(1), damping(0.001), fadein_ms(0), position_serial(0),
+          fade_force(false), fade_force_up(false), fade_force_time(0), fade_force_serial(0) {}
+
+        double stiffness;
+        double damping;
+
+        osg::Vec3d target_position;
+        double fadein_ms;
+        unsigned int position_serial; // Incremented for each call to setPosition()
+
+        bool fade_force, fade_force_up;
+        double fade_force_time;
+        unsigned int fade_force_serial; // Incremented for each call to setEnable()
+      };
+
+      // Application side copy of the parameters, protected by m_mutex
+      Parameters m_parameters;
+      ParameterBuffer<Parameters> m_parameter_buffer;
       double m_max_stiffness;
-      osg::Vec3d m_position, m_target_position, m_current_position;
+
+      // Servo side state
+      unsigned int m_position_serial;
+      osg::Vec3d m_position, m_current_position;
       bool m_fade;
-      bool m_fade_started;
-      double m_fadein_ms, m_fade_start_time;
+      double m_fade_start_time;
 
       double m_current_fade;
-      bool m_fade_force, m_fade_force_started;
-      double m_fade_force_start_time, m_fade_force_time;
-      bool m_fade_force_up;
+      unsigned int m_fade_force_serial;
+      bool m_fade_force;
+      double m_fade_force_start_time;
     };
 
   } // namespace osgHaptics
@@ -0,0 +1,113 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __SpringGroupForceOperator_h__
+#define __SpringGroupForceOperator_h__
+
+#include <osgHaptics/ForceOperator.h>
+#include <osgHaptics/export.h>
+#include <osg/Vec3d>
+
+#include <vector>
+
+
+  namespace osgHaptics {
+
+    /// A set of springs evaluated as one ForceOperator.
+
+    /*!
+      Replaces hundreds of SpringForceOperators (one virtual call each per servo tick) with a single one.
+      The servo thread gets the enabled springs as a structure of arrays, summed in one loop
+      the compiler can vectorize. The sum of all springs is clamped as one force by the ServoLoop.
+      Each spring pulls the device towards an anchor in world coordinates with k*x and damps with -b*v,
+      like SpringForceOperator, but without the position and stiffness fading.
+    */
+    class OSGHAPTICS_EXPORT SpringGroupForceOperator : public ForceOperator {
+    public:
+      SpringGroupForceOperator();
+
+      /// Add a spring with its anchor at position, return the index of the spring
+      unsigned int addSpring(const osg::Vec3d& position, double stiffness=1, double damping=0.001);
+
+      /// Remove all springs
+      void removeAllSprings();
+
+      /// Return the number of springs, enabled or not
+      unsigned int getNumSprings() const;
+
+      /// Set the anchor position of spring i
+      void setPosition(unsigned int i, const osg::Vec3d& position);
+      osg::Vec3d getPosition(unsigned int i) const;
+
+      /// Set the anchor positions of the first positions.size() springs, publishing them all at once
+      void setPositions(const std::vector<osg::Vec3d>& positions);
+
+      void setStiffness(unsigned int i, double stiffness);
+      double getStiffness(unsigned int i) const;
+
+      void setDamping(unsigned int i, double damping);
+      double getDamping(unsigned int i) const;
+
+      /// Enable/disable spring i, disabled springs are not sent to the servo thread at all
+      void setSpringEnable(unsigned int i, bool flag);
+      bool getSpringEnable(unsigned int i) const;
+
+      using ForceOperator::calculateForce;
+      using ForceOperator::calculateTorque;
+
+      virtual void calculateForce( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out );
+      virtual void calculateTorque( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out ) { out = in; }
+
+    protected:
+
+      /// Destructor
+      virtual ~SpringGroupForceOperator() {}
+
+    private:
+
+      /// Application side description of a spring
+      struct Spring {
+        osg::Vec3d position;
+        double stiffness;
+        double damping;
+        bool enabled;
+      };
+
+      /// The enabled springs as a structure of arrays, as read by the servo thread
+      struct Parameters {
+        Parameters() : total_damping(0) {}
+        std::vector<double> x, y, z, stiffness;
+        double total_damping; // Sum of the damping of all enabled springs
+      };
+
+      /// Rebuild m_parameters from m_springs and publish it. m_mutex must be held.
+      void publish();
+
+      // Application side, protected by m_mutex
+      std::vector<Spring> m_springs;
+      Parameters m_parameters;
+      ParameterBuffer<Parameters> m_parameter_buffer;
+      double m_max_stiffness;
+    };
+
+  } // namespace osgHaptics
+
+#endif
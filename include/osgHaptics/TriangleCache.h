@@ -0,0 +1,117 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_TriangleCache_h__
+#define __osgHaptics_TriangleCache_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/BoundingVolumeHierarchy.h>
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Node>
+#include <osg/Vec3>
+#include <vector>
+#include <string>
+
+
+namespace osgHaptics {
+
+/// The triangles of a scene in world coordinates with a hierarchy over them, stored in a file that is memory mapped.
+
+/*!
+  Extracting the triangles of a large model and building a spatial index over them takes a long time at every start.
+  The TriangleCache stores the result in a file, laid out exactly as the arrays are in memory. Opening the file
+  maps it into memory and queries run directly on the mapping, so nothing is parsed or allocated per triangle.
+
+  The file is keyed by a hash of the content of the scene, computeKey(). A cache of an older version of the model 
+  is therefore never used. The file is only valid on machines with the same byte order and structure layout as 
+  the writer, which is verified when it is opened.
+
+  Typical use:
+
+    osg::ref_ptr<TriangleCache> cache = new TriangleCache;
+    cache->load("model.ohcache", *model);
+*/
+class OSGHAPTICS_EXPORT TriangleCache : public osg::Referenced
+{
+public:
+  typedef unsigned long long Key;
+
+  /// The items are triangle indices
+  typedef BoundingVolumeHierarchy<unsigned int> Hierarchy;
+
+  TriangleCache();
+
+  /// Return a hash of the vertices, primitive sets and transforms of the geometries in node
+  static Key computeKey(osg::Node& node);
+
+  /*!
+    Open filename if it is a cache of node, otherwise extract the triangles of node and write them to filename.
+    \return true if the triangles were read from the file
+  */
+  bool load(const std::string& filename, osg::Node& node, unsigned int num_threads=0);
+
+  /// Extract the triangles of node in world coordinates on num_threads threads, and build the hierarchy over them
+  void build(osg::Node& node, Key key, unsigned int num_threads=0);
+
+  /// Write the triangles and the hierarchy to filename, returns false on failure
+  bool write(const std::string& filename) const;
+
+  /// Map filename into memory, returns false if it can not be read or was written for another key
+  bool open(const std::string& filename, Key key);
+
+  /// Release the triangles, and unmap the file if one is open
+  void close();
+
+  /// Returns true if the triangles are in a mapped file
+  bool isMapped() const { return m_file != 0L; }
+
+  Key getKey() const { return m_key; }
+
+  /// Three vertices per triangle in world coordinates
+  const osg::Vec3 *getVertices() const { return m_vertex_data; }
+
+  unsigned int getNumTriangles() const { return m_num_triangles; }
+
+  /// Return the hierarchy of the bounding boxes of the triangles
+  const Hierarchy *getHierarchy() const { return m_hierarchy.get(); }
+
+protected:
+  virtual ~TriangleCache();
+
+private:
+  struct MappedFile;
+
+  Key m_key;
+  std::vector<osg::Vec3> m_vertices;
+  const osg::Vec3 *m_vertex_data;
+  unsigned int m_num_triangles;
+  osg::ref_ptr<Hierarchy> m_hierarchy;
+  MappedFile *m_file;
+
+  // Not copyable
+  TriangleCache(const TriangleCache&);
+  TriangleCache& operator=(const TriangleCache&);
+};
+
+} // namespace osgHaptics
+
+#endif
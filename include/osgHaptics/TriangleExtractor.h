@@ -83,6 +83,65 @@ namespace osgHaptics {
   typedef osg::TriangleFunctor<TriangleExtractOperatorBase> TriangleExtractOperator;
 
 
+  /// The triangles of one geometry as indices into its untransformed vertex array
+
+  /*!
+    The vertices point straight into the Vec3Array of the geometry, nothing is copied or transformed.
+    Only geometries with some other vertex array type or with vertex indices have their triangle
+    vertices copied, see isCopy().
+    Degenerate triangles are skipped, like for TriangleExtractOperator.
+  */
+  class OSGHAPTICS_EXPORT TriangleBatch 
+  {
+  public:
+    friend class TriangleExtractor;
+
+    TriangleBatch() : m_geometry(0L), m_vertices(0L), m_num_vertices(0) {}
+
+    /// The geometry the triangles come from
+    const osg::Geometry *getGeometry() const { return m_geometry; }
+
+    /// The vertices in the local coordinates of the geometry
+    const osg::Vec3 *getVertices() const { return m_vertices; }
+    unsigned int getNumVertices() const { return m_num_vertices; }
+
+    /// Three indices into getVertices() per triangle
+    const std::vector<unsigned int>& getIndices() const { return m_indices; }
+    unsigned int getNumTriangles() const { return m_indices.size()/3; }
+
+    /// The accumulated matrix from the local coordinates of the geometry to world coordinates
+    const osg::Matrix& getMatrix() const { return m_matrix; }
+
+    /// Returns true if the vertices are a copy and not the vertex array of the geometry
+    bool isCopy() const { return !m_copied_vertices.empty(); }
+
+    /// Transform each vertex once into world coordinates, so that world[i] corresponds to getVertices()[i]
+    void transformVertices(std::vector<osg::Vec3>& world) const;
+
+  private:
+    const osg::Geometry *m_geometry;
+    const osg::Vec3 *m_vertices;
+    unsigned int m_num_vertices;
+    std::vector<unsigned int> m_indices;
+    osg::Matrix m_matrix;
+    std::vector<osg::Vec3> m_copied_vertices;
+  };
+
+
+  /// Base class for operators that are executed once per geometry with all of its triangles
+  class OSGHAPTICS_EXPORT TriangleBatchOperator : public osg::Referenced
+  {
+  public:
+
+    /*!
+      This method is a pure virtual method that has to be inherited.
+      It is called for each geometry with at least one triangle. The batch is reused for the 
+      next geometry, so anything needed later has to be copied out of it.
+    */
+    virtual void batch(const TriangleBatch& batch) =0;
+  };
+
+
   /// This class traverses a subgraph, accumulates transformations and excute a functor (TriangleExtractOperator per triangle.
   /*!
 
@@ -100,6 +159,12 @@ namespace osgHaptics {
     */
     TriangleExtractor(TriangleExtractOperator &op);
 
+    /*!
+    Constructor.
+    \param op - Is the functor operator which batch method will be executed once for each geometry found during traversal. 
+    */
+    TriangleExtractor(TriangleBatchOperator &op);
+
     /// Destructor
     virtual ~TriangleExtractor(){};
 
@@ -117,8 +182,15 @@ namespace osgHaptics {
     \param node - The subgraph from which the triangles will be extracted.
     */
     void extract(osg::Transform& node) { apply(node); }
+
+    /// Fill batch with the triangles of geom, matrix is the transformation to world coordinates
+    static void extractBatch(const osg::Geometry& geom, const osg::Matrix& matrix, TriangleBatch& batch);
+
   protected:
 
+    /// Used by ParallelTriangleExtractor, which handles the geometries itself
+    TriangleExtractor();
+
     virtual void apply(osg::Node&);
     virtual void apply(osg::Geode& node);
     virtual void apply(osg::Billboard& node);
@@ -128,20 +200,67 @@ namespace osgHaptics {
     virtual void apply(osg::Switch& node);
     virtual void apply(osg::LOD& node);
 
-    void apply(osg::Geometry& geom);
+    virtual void apply(osg::Geometry& geom);
+
+    /// Return the accumulated matrix of the current position in the traversal
+    const osg::Matrix& getMatrix() const;
 
     void pushMatrix(const osg::Matrix& matrix);
     void popMatrix();
 
 
 
-    TriangleExtractOperator & m_tri_op;
+    /// Only one of the operators is set
+    TriangleExtractOperator *m_tri_op;
+    TriangleBatchOperator *m_batch_op;
 
   private:
     unsigned int m_num_triangles;
-    typedef std::vector<osg::ref_ptr<osg::RefMatrix> > MatrixStack;
+    typedef std::vector<osg::Matrix> MatrixStack;
 
     MatrixStack m_matrix_stack;
+
+    TriangleBatch m_batch;
+  };
+
+
+  /// Extracts the triangles of a subgraph in world coordinates on several threads
+
+  /*!
+    The traversal only collects each geometry together with its accumulated matrix. The geometries are then
+    triangulated and transformed by a number of threads, each one into its own buffer, and the buffers are 
+    merged in traversal order at the end. The result is therefore the same as from a TriangleExtractOperator.
+    The geometries must not be modified during extract().
+  */
+  class OSGHAPTICS_EXPORT ParallelTriangleExtractor : public TriangleExtractor
+  {
+  public:
+
+    /// Constructor, 0 threads means one per processor
+    ParallelTriangleExtractor(unsigned int num_threads=0);
+
+    void setNumThreads(unsigned int num_threads) { m_num_threads = num_threads; }
+    unsigned int getNumThreads() const { return m_num_threads; }
+
+    /*!
+    Extract the triangles of the subgraph node.
+    \param vertices - Three vertices per triangle in world coordinates are stored here, degenerate triangles are skipped
+    */
+    void extract(osg::Node& node, std::vector<osg::Vec3>& vertices);
+
+    /// A geometry found during traversal, with the matrix from its local coordinates to world coordinates
+    struct WorkItem {
+      WorkItem(const osg::Geometry *g, const osg::Matrix& m) : geometry(g), matrix(m) {}
+      const osg::Geometry *geometry;
+      osg::Matrix matrix;
+    };
+
+  protected:
+    virtual void apply(osg::Geometry& geom);
+
+  private:
+    unsigned int m_num_threads;
+    std::vector<WorkItem> m_items;
   };
 
 
@@ -0,0 +1,131 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_TriangleInstances_h__
+#define __osgHaptics_TriangleInstances_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/TriangleSet.h>
+#include <osgHaptics/BoundingVolumeHierarchy.h>
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Geometry>
+#include <osg/Matrix>
+#include <osg/Node>
+#include <vector>
+#include <map>
+
+
+namespace osgHaptics {
+
+/// The triangles of a subgraph as one shared TriangleSet per unique geometry and the transforms it is instanced with.
+
+/*!
+  A geometry that occurs at several positions in the scenegraph is triangulated once, each occurence only adds 
+  an Instance with its accumulated matrix. Spatial structures can then refer to the triangles with a TriangleRef
+  instead of storing transformed copies, and the scene does not have to be deep copied to remove the instancing.
+*/
+class OSGHAPTICS_EXPORT TriangleInstances : public osg::Referenced
+{
+public:
+
+  /// A triangle of one instance
+  struct TriangleRef {
+    TriangleRef() : instance(0), triangle(0) {}
+    TriangleRef(unsigned int i, unsigned int t) : instance(i), triangle(t) {}
+
+    bool operator < (const TriangleRef& rhs) const 
+    { 
+      return instance < rhs.instance || (instance == rhs.instance && triangle < rhs.triangle); 
+    }
+    bool operator == (const TriangleRef& rhs) const { return instance == rhs.instance && triangle == rhs.triangle; }
+
+    unsigned int instance, triangle;
+  };
+
+  /// An occurence of a geometry in the scenegraph
+  struct Instance {
+    /// Index into getTriangleSets()
+    unsigned int triangle_set;
+
+    /// From the local coordinates of the geometry to world coordinates, and back
+    osg::Matrix matrix, inverse;
+
+    /// Bounding box of the triangles in world coordinates
+    osg::BoundingBox bound;
+  };
+
+  TriangleInstances();
+
+  /// Collect the geometries of the subgraph node, replacing the current instances
+  void extract(osg::Node& node);
+
+  /// Add an occurence of geometry, matrix is the transformation from its local coordinates to world coordinates
+  void addInstance(const osg::Geometry& geometry, const osg::Matrix& matrix);
+
+  void clear();
+
+  /// The triangles of the unique geometries, in their local coordinates
+  const std::vector< osg::ref_ptr<TriangleSet> >& getTriangleSets() const { return m_triangle_sets; }
+
+  const std::vector<Instance>& getInstances() const { return m_instances; }
+
+  /// Return the number of triangles of all instances, that is counting a shared triangle once per instance
+  unsigned int getNumTriangles() const;
+
+  /// Return the vertices of a triangle in world coordinates
+  void getTriangle(const TriangleRef& ref, osg::Vec3& v1, osg::Vec3& v2, osg::Vec3& v3) const;
+
+  /*!
+    Return the world bounding box of every triangle of every instance together with its reference,
+    the input for HashedGrid::build() or BoundingVolumeHierarchy::build().
+  */
+  void getTriangleBounds(std::vector<osg::BoundingBox>& bounds, std::vector<TriangleRef>& refs) const;
+
+  /*!
+    Return the triangles that might be within radius from center, given in world coordinates.
+    The instances are found with a hierarchy over their bounding boxes, and the triangles with the hierarchy
+    of their TriangleSet. Not thread safe, the query buffers are kept between the calls.
+  */
+  void query(const osg::Vec3& center, float radius, std::vector<TriangleRef>& result);
+
+protected:
+  virtual ~TriangleInstances() {}
+
+private:
+  typedef BoundingVolumeHierarchy<unsigned int> InstanceHierarchy;
+
+  std::vector< osg::ref_ptr<TriangleSet> > m_triangle_sets;
+  std::vector<Instance> m_instances;
+
+  /// The index in m_triangle_sets for each geometry
+  std::map<const osg::Geometry *, unsigned int> m_set_indices;
+
+  /// Over the bounds of m_instances, built by the first query after an instance is added
+  osg::ref_ptr<InstanceHierarchy> m_hierarchy;
+
+  InstanceHierarchy::QueryResult m_instance_result;
+  TriangleSet::Hierarchy::QueryResult m_triangle_result;
+};
+
+} // namespace osgHaptics
+
+#endif
@@ -0,0 +1,108 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __osgHaptics_TriangleSet_h__
+#define __osgHaptics_TriangleSet_h__
+
+#include <osgHaptics/export.h>
+#include <osgHaptics/BoundingVolumeHierarchy.h>
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Drawable>
+#include <osg/Vec3>
+#include <OpenThreads/Mutex>
+#include <vector>
+#include <utility>
+
+
+namespace osgHaptics {
+
+/// The triangles of a drawable in its local coordinates, with a hierarchy for proximity queries.
+
+/*!
+  The haptic render pass draws the cached vertices instead of decoding strips, fans and indices of the
+  drawable every frame, and uses the hierarchy to send only the triangles near the proxy to HL.
+  get() extracts the triangles of a drawable the first time it is asked for, and then returns the same
+  TriangleSet, for all devices, until the drawable is modified or deleted.
+  A geometry counts as modified when its vertex array is replaced or dirtied, or when a primitive set is
+  added, removed, replaced or dirtied.
+  buildLODs() adds simplified versions of the triangles, which the haptic render pass sends instead of the 
+  full triangles when the drawable is far from the proxy.
+*/
+class OSGHAPTICS_EXPORT TriangleSet : public osg::Referenced
+{
+public:
+
+  /// The items are triangle indices
+  typedef BoundingVolumeHierarchy<unsigned int> Hierarchy;
+
+  /// Extract the triangles of drawable
+  TriangleSet(const osg::Drawable& drawable);
+
+  /// Return the triangles of drawable, extracted again whenever the drawable has been modified since the last call
+  static TriangleSet *get(const osg::Drawable& drawable);
+
+  /// Return the triangles of drawable if they have been extracted and it is not modified since, never extracts
+  static TriangleSet *find(const osg::Drawable& drawable);
+
+  /// Return true if drawable has been modified after the triangles were extracted from it
+  bool isModified(const osg::Drawable& drawable) const;
+
+  /// Three vertices per triangle, degenerate triangles are skipped
+  const std::vector<osg::Vec3>& getVertices() const { return m_vertices; }
+
+  unsigned int getNumTriangles() const { return m_vertices.size()/3; }
+
+  /// Return the hierarchy of the bounding boxes of the triangles, built on the first call
+  const Hierarchy *getHierarchy() const;
+
+  /*!
+    Build simplified levels of the triangles with a MeshDecimator, level i+1 having reduction times the triangles of level i.
+    Fewer levels are built when the triangles can not be simplified further. Call before the drawable is rendered.
+    The levels are dropped when the drawable is modified, a deforming drawable is then rendered at full resolution
+    until buildLODs() is called on the TriangleSet returned by get().
+  */
+  void buildLODs(unsigned int num_levels, float reduction=0.25f);
+
+  /// Return the number of levels of detail, including the full triangles at level 0
+  unsigned int getNumLODs() const { return m_lods.size()+1; }
+
+  /// Three vertices per triangle of level, level 0 being getVertices()
+  const std::vector<osg::Vec3>& getLODVertices(unsigned int level) const { return level ? m_lods[level-1] : m_vertices; }
+
+protected:
+  virtual ~TriangleSet() {}
+
+private:
+  std::vector<osg::Vec3> m_vertices;
+
+  /// The vertex array and each primitive set of the drawable with their modified counts when the triangles were extracted
+  std::vector< std::pair<const void *, unsigned int> > m_source_version;
+
+  std::vector< std::vector<osg::Vec3> > m_lods;
+
+  mutable OpenThreads::Mutex m_hierarchy_mutex;
+  mutable osg::ref_ptr<Hierarchy> m_hierarchy;
+};
+
+} // namespace osgHaptics
+
+#endif
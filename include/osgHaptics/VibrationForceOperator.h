@@ -31,20 +31,35 @@ namespace osgHaptics {
     class OSGHAPTICS_EXPORT VibrationForceOperator : public ForceOperator {
     public:
       
-      /// Default constructor
-      VibrationForceOperator();
+      /*!
+        Constructor. The amplitude is limited to the nominal continuous force of device. Without a device the
+        current HD device is queried if there is one, otherwise the amplitude is only clamped by the servo loop.
+      */
+      VibrationForceOperator(HapticDevice *device=0L);
 
       void setDirection( osg::Vec3d& direction );
-      osg::Vec3d getDirection() const { return m_direction; }
+      osg::Vec3d getDirection() const { 
+        OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+        return m_parameters.direction; 
+      }
 
       void setFrequency( float f );
-      double getFrequency() const { return m_frequency; }
+      double getFrequency() const { 
+        OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+        return m_parameters.frequency; 
+      }
 
       void setAmplitude( double amplitude );
-      double getAmplitude() const { return m_amplitude; }
+      double getAmplitude() const { 
+        OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+        return m_parameters.amplitude; 
+      }
 
-      virtual void calculateForce( const osg::Vec3d& in, osg::Vec3d& out, double time );
-      virtual void calculateTorque( const osg::Vec3d& in, osg::Vec3d& out, double time ) { out = in; }
+      using ForceOperator::calculateForce;
+      using ForceOperator::calculateTorque;
+
+      virtual void calculateForce( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out );
+      virtual void calculateTorque( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out ) { out = in; }
 
     protected:
       
@@ -52,10 +67,19 @@ namespace osgHaptics {
       virtual ~VibrationForceOperator() {}
 
     private:
-      double m_amplitude;
-      double m_max_amplitude;
-      float m_frequency;
-      osg::Vec3d m_direction;
+
+      /// Parameters published to the servo thread as one consistent set
+      struct Parameters {
+        Parameters() : amplitude(0), frequency(0), direction(0,1,0) {}
+        double amplitude;
+        float frequency;
+        osg::Vec3d direction;
+      };
+
+      // Application side copy of the parameters, protected by m_mutex
+      Parameters m_parameters;
+      ParameterBuffer<Parameters> m_parameter_buffer;
+      double m_max_amplitude; // 0 if unknown
     };
 
   } // namespace osgHaptics
@@ -0,0 +1,115 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#ifndef __VibrationGroupForceOperator_h__
+#define __VibrationGroupForceOperator_h__
+
+#include <osgHaptics/ForceOperator.h>
+#include <osgHaptics/export.h>
+#include <osg/Vec3d>
+
+#include <vector>
+
+
+namespace osgHaptics {
+
+    /// A set of vibrations evaluated as one ForceOperator.
+
+    /*!
+      The batched counterpart of VibrationForceOperator: the servo thread gets the enabled vibrations as a
+      structure of arrays and sums direction*amplitude*sin(2*pi*frequency*t) over all of them in one loop.
+      Directions are in workspace coordinates.
+    */
+    class OSGHAPTICS_EXPORT VibrationGroupForceOperator : public ForceOperator {
+    public:
+
+      /*!
+        Constructor. Amplitudes are limited to the nominal continuous force of device. Without a device the
+        current HD device is queried if there is one, otherwise amplitudes are only clamped by the servo loop.
+      */
+      VibrationGroupForceOperator(HapticDevice *device=0L);
+
+      /// Add a vibration, return its index
+      unsigned int addVibration(const osg::Vec3d& direction, double frequency, double amplitude);
+
+      /// Remove all vibrations
+      void removeAllVibrations();
+
+      /// Return the number of vibrations, enabled or not
+      unsigned int getNumVibrations() const;
+
+      void setDirection(unsigned int i, const osg::Vec3d& direction);
+      osg::Vec3d getDirection(unsigned int i) const;
+
+      void setFrequency(unsigned int i, double frequency);
+      double getFrequency(unsigned int i) const;
+
+      void setAmplitude(unsigned int i, double amplitude);
+      double getAmplitude(unsigned int i) const;
+
+      /// Enable/disable vibration i, disabled vibrations are not sent to the servo thread at all
+      void setVibrationEnable(unsigned int i, bool flag);
+      bool getVibrationEnable(unsigned int i) const;
+
+      using ForceOperator::calculateForce;
+      using ForceOperator::calculateTorque;
+
+      virtual void calculateForce( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out );
+      virtual void calculateTorque( const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out ) { out = in; }
+
+    protected:
+
+      /// Destructor
+      virtual ~VibrationGroupForceOperator() {}
+
+    private:
+
+      struct Vibration {
+        osg::Vec3d direction;
+        double frequency;
+        double amplitude;
+        bool enabled;
+      };
+
+      /// The enabled vibrations as a structure of arrays, direction premultiplied with the amplitude
+      struct Parameters {
+        std::vector<double> x, y, z, omega;
+
+        /*!
+          Servo side scratch for the sine of each vibration. Sized by publish(), so calculateForce() never
+          allocates. Only the servo thread writes it, in the buffer it currently owns for reading.
+        */
+        mutable std::vector<double> sine;
+      };
+
+      /// Rebuild m_parameters from m_vibrations and publish it. m_mutex must be held.
+      void publish();
+
+      // Application side, protected by m_mutex
+      std::vector<Vibration> m_vibrations;
+      Parameters m_parameters;
+      ParameterBuffer<Parameters> m_parameter_buffer;
+      double m_max_amplitude; // 0 if unknown
+    };
+
+  } // namespace osgHaptics
+
+#endif
@@ -0,0 +1,116 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/ForceModelWorker.h>
+#include <osg/Timer>
+#include <osg/Notify>
+#include <OpenThreads/ScopedLock>
+
+using namespace osgHaptics;
+
+
+ForceModelWorker::ForceModelWorker(ParameterBuffer<ServoFrame> *frames) : m_frames(frames), m_running(true)
+{
+  start();
+}
+
+ForceModelWorker::~ForceModelWorker()
+{
+  close();
+}
+
+void ForceModelWorker::close()
+{
+  if (!m_running)
+    return;
+
+  stop();
+  if (isRunning() && !wait(2000)) {
+    osg::notify(osg::WARN) << "ForceModelWorker::close(): Unable to stop the worker thread" << std::endl;
+    cancel();
+  }
+  m_running = false;
+}
+
+void ForceModelWorker::addForceOperator(ForceOperator *fo)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  Entry e;
+  e.fo = fo;
+  e.next_time = 0;
+  m_entries.push_back(e);
+}
+
+void ForceModelWorker::removeForceOperator(ForceOperator *fo)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  std::vector<Entry>::iterator it = m_entries.begin();
+  while(it != m_entries.end()) {
+    if (it->fo.get() == fo)
+      it = m_entries.erase(it);
+    else
+      it++;
+  }
+}
+
+void ForceModelWorker::run()
+{
+  osg::Timer *timer = osg::Timer::instance();
+  osg::Timer_t start = timer->tick();
+  LocalForceModel model;
+
+  while (!shouldStop()) {
+    double now = timer->delta_s(start, timer->tick());
+
+    // The most recent state of the device, written by the servo thread every tick.
+    // Until the first frame is written there is no state to linearize around, and the servo loop 
+    // outputs no force for these operators.
+    const ServoFrame& frame = m_frames->read();
+    if (!frame.valid) {
+      OpenThreads::Thread::microSleep(1000);
+      continue;
+    }
+
+    m_mutex.lock();
+    std::vector<Entry>::iterator it = m_entries.begin();
+    for(; it != m_entries.end(); it++) {
+      if (now < it->next_time)
+        continue;
+
+      ForceOperator *fo = it->fo.get();
+      double rate = fo->getEvaluationRate();
+      it->next_time = now + (rate > 0 ? 1.0/rate : 0);
+
+      if (!fo->getEnable())
+        continue;
+
+      model = LocalForceModel();
+      fo->calculateForceModel(frame, model);
+      fo->m_force_model.write(model);
+    }
+    m_mutex.unlock();
+
+    // Good enough resolution for rates up to a few hundred Hz
+    OpenThreads::Thread::microSleep(1000);
+  }
+
+  exit();
+}
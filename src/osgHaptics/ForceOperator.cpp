@@ -25,7 +25,15 @@ using namespace osgHaptics;
 
 void ForceOperator::update()
 {
-  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  // Has trig() been called since last tick?
+  const TrigParameters& p = m_trig_buffer.read();
+  if (p.serial != m_trig_serial) {
+    m_trig_serial = p.serial;
+    m_start = p.start;
+    m_duration = p.duration;
+    m_trigged = true;
+  }
+
   if (!m_trigged)
     return;
 
@@ -34,7 +42,7 @@ void ForceOperator::update()
   double delta = osg::Timer::instance()->delta_m(m_start, now);
   if (delta >= m_duration)
   {
-    m_enabled = false;
+    m_enabled.exchange(0);
     m_trigged=false;
     m_duration=0;
     m_start=0;
@@ -45,21 +53,34 @@ void ForceOperator::update()
 void ForceOperator::trig(unsigned int milliseconds_duration)
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m_enabled = true;
-  m_duration =  milliseconds_duration;
-  m_start = osg::Timer::instance()->tick();
-  m_trigged = true;
-}
+  m_trig_parameters.serial++;
+  m_trig_parameters.duration = milliseconds_duration;
+  m_trig_parameters.start = osg::Timer::instance()->tick();
+  m_trig_buffer.write(m_trig_parameters);
 
-void ForceOperator::setWorldToWorkSpaceMatrix(const osg::Matrix& m)
-{
-  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m_world_to_workspace_matrix = m;
-  m_workspace_to_world_matrix = m.inverse(m);
+  m_enabled.exchange(1);
 }
 
-void ForceOperator::getWorldToWorkSpaceMatrix(osg::Matrix& m) const
+void ForceOperator::calculateForceModel(const ServoFrame& frame, LocalForceModel& model)
 {
-  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m = m_world_to_workspace_matrix;
+  osg::Vec3d zero(0,0,0);
+  calculateForce(frame, zero, model.force);
+  calculateTorque(frame, zero, model.torque);
+  model.position = frame.position;
+
+  // Forward differences, with a step small compared to the workspace but well above the device resolution
+  const double h = 0.5;
+  ServoFrame displaced = frame;
+  for(unsigned int c=0; c < 3; c++) {
+    displaced.position = frame.position;
+    displaced.position[c] += h;
+    displaced.transform(3,c) = displaced.position[c];
+
+    osg::Vec3d f;
+    calculateForce(displaced, zero, f);
+    for(unsigned int r=0; r < 3; r++)
+      model.jacobian[r*3+c] = (f[r]-model.force[r])/h;
+  }
+
+  model.valid = true;
 }
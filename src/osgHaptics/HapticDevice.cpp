@@ -53,6 +53,8 @@ osg::Timer_t HapticDevice::m_start_tick=0;
 
 bool HapticDevice::m_scheduler_started = false;
 
+const char *HapticDevice::SIMULATED_DEVICE = "osgHaptics::SimulatedDevice";
+
 
 HapticDevice::HapticDevice(HDstring pConfigName) : 
     Sensor(), 
@@ -70,7 +72,13 @@ HapticDevice::HapticDevice(HDstring pConfigName) :
     m_proxy_stiffness(0.3), 
     m_shutting_down(false), 
     m_enable_shape_render(true), 
+    m_adaptive_viewport_enabled(false), 
+    m_cull_radius(0), 
+    m_cull_look_ahead(0), 
+    m_max_culled_triangles(0), 
+    m_lod_distance(0), 
     m_max_force(0), 
+    m_max_continuous_force(0), 
     m_device_model(NONE_DEVICE), 
     m_workspace_model(VIEW_WORKSPACE),
 
@@ -81,8 +89,8 @@ HapticDevice::HapticDevice(HDstring pConfigName) :
 {
   m_start_tick = osg::Timer::instance()->tick();
 
- 
-  //m_log_stream.open("haptics.log", std::ios_base::trunc);
+  m_servo_loop = new ServoLoop;
+  m_render_force_filter = new RenderForceFilter;
 
   initDevice(pConfigName);
 }
@@ -172,6 +180,12 @@ void HapticDevice::updateWorkspace(unsigned int width, unsigned int height,
 
 	m_modelview_matrix = modelView;
 
+  // Without HL there is no touch workspace, the simulated device works directly in view coordinates
+  if (isSimulated()) {
+    if (getWorkspaceModel() == VIEW_WORKSPACE)
+      setWorldToWorkSpaceMatrix(m_modelview_matrix);
+    return;
+  }
 
 
   //--by SophiaSoo/CUHK: for two arms
@@ -253,6 +267,10 @@ void HapticDevice::updateWorkspace(unsigned int width, unsigned int height,
 HapticDevice::~HapticDevice()
 {
   shutdown(0.0f);
+
+  // Operators might have been added to a device that never got a context
+  m_servo_loop->removeAllForceOperators();
+  m_servo_loop->stopTrace();
 }
 
 
@@ -367,6 +385,12 @@ void HapticDevice::initDevice(HDstring pConfigName)
 		return;
 	}
 
+  if (pConfigName && std::string(pConfigName) == SIMULATED_DEVICE) {
+    m_simulated_device = new SimulatedDevice(this);
+    m_initDevice = true;
+    return;
+  }
+
 	HDErrorInfo error;
 
   m_hHDHandle = hdInitDevice(pConfigName);
@@ -404,6 +428,21 @@ void HapticDevice::createContext()
 
   m_position_scale.set(1,1,1);
 
+  if (isSimulated()) {
+    m_force_output_enabled = true;
+    m_force_clamping_enabled = true;
+    m_max_force = m_simulated_device->getParameters().max_force;
+    m_max_continuous_force = m_max_force;
+    m_servo_loop->setMaxForce(m_max_force);
+
+    // The SimulatedDevice calls runServoTick() from its own thread instead of the HD scheduler
+    m_servo_loop->setTicking(true);
+    m_simulated_device->startScheduler();
+
+    m_initialized = true;
+    return;
+  }
+
   m_hHLRContext = hlCreateContext(m_hHDHandle);
   makeCurrent();
 
@@ -435,10 +474,27 @@ void HapticDevice::createContext()
 
   // Check what the max force is
   hdGetDoublev(HD_NOMINAL_MAX_FORCE, &m_max_force);
+  hdGetDoublev(HD_NOMINAL_MAX_CONTINUOUS_FORCE, &m_max_continuous_force);
+  m_servo_loop->setMaxForce(m_max_force);
 
   m_initialized = true;
 }
 
+void HapticDevice::readServoInput(ServoInput& input)
+{
+  input.time = getTimeStamp();
+  hdGetDoublev( HD_CURRENT_TRANSFORM, input.transform );
+  hdGetDoublev( HD_CURRENT_VELOCITY, input.velocity );
+  hdGetDoublev( HD_LAST_VELOCITY, input.last_velocity );
+  hdGetDoublev( HD_CURRENT_ANGULAR_VELOCITY, input.angular_velocity );
+
+  // The force and torque rendered so far this frame, the ForceOperators will add to it
+  hdGetDoublev( HD_CURRENT_FORCE, input.force );
+  hdGetDoublev( HD_CURRENT_TORQUE, input.torque );
+  hdGetIntegerv( HD_CURRENT_BUTTONS, &input.buttons );
+  input.pad = 0;
+}
+
 HDCallbackCode HDCALLBACK HapticDevice::forceEffectCB( void *data ) {
   HapticDevice *device = static_cast< HapticDevice * >( data );
     
@@ -446,80 +502,44 @@ HDCallbackCode HDCALLBACK HapticDevice::forceEffectCB( void *data ) {
   hdMakeCurrentDevice(device->getHandle());
 
   // get current values from HD API 
-  HLdouble m[16];
-  hdGetDoublev( HD_CURRENT_TRANSFORM, m );
-  osg::Matrix matrix(
-      m[0], m[1], m[2], m[3],
-      m[0], m[1], m[2], m[3],
-      m[0], m[1], m[2], m[3],
-      m[0], m[1], m[2], m[3]);
-
-    hdGetDoublev( HD_CURRENT_VELOCITY, m );
-    osg::Vec3 velocity( m[0],  m[1], m[2] );
-    
+  ServoInput input;
+  readServoInput(input);
 
-    // add the resulting force and torque to the rendered force.
-    osg::Vec3d force;
-    hdGetDoublev( HD_CURRENT_FORCE,force.ptr() );
+  osg::Vec3d force, torque;
+  device->runServoTick(input, force, torque);
 
-    osg::Vec3d torque;
-    hdGetDoublev( HD_CURRENT_TORQUE,torque.ptr() );
-
-    // Transform the internal Hapticforce to a force in world coordinates
-    //force = device->m_touch_to_world_matrix.preMult(force);
-
-    // Transform force and torque into World coordinates
-    osg::Matrix w2w_matrix;
-    bool is_valid = device->getWorldToWorkSpaceMatrix(w2w_matrix);
-  
-    // is_valid is only true when we have update the matrix
-    // As this is done in a separate thread we have to make sure
-    if (is_valid) {
-      double current_time = device->getTimeStamp();
-      device->m_log_stream << current_time;
-
-      // Iterate over all ForceOperators and add the force together
-      OpenThreads::ScopedLock<OpenThreads::Mutex> sl(device->m_fo_mutex);
-      ForceOperatorMap::iterator it=device->m_force_operators.begin();
-      for(;it != device->m_force_operators.end(); it++) {
-        it->first->update();
-
-        // Set the WorldToHapticWorkspace matrix
-        it->first->setWorldToWorkSpaceMatrix(w2w_matrix);
-        if (it->first->getEnable()) {
-          osg::Vec3d out;
-          it->first->calculateForce(force, out, current_time);
-          double l = out.length2();
-          if (l > device->getMaxForce2()) {
-            l = sqrt(l);          
-            out.normalize();
-            out *= l;
-            //device->warning("forceEffectCB") << "ForceOperator delivered too large force: " << out << std::endl;
-          }
-          force += out;
-          it->first->calculateTorque(torque, out, current_time);
-          torque += out;
-        }
-      } // for
-    } // if is_valid
-
-    double l = force.length2();
-    if (l > device->getMaxForce2()) {
-      l = sqrt(l);
-      force *= l;
-      //device->warning("forceEffectCB") << "Total force exeeds maximum: " << force << std::endl;
-    }
-
-    hdSetDoublev( HD_CURRENT_FORCE, force.ptr() );
-    hdSetDoublev( HD_CURRENT_TORQUE, torque.ptr() );
+  hdSetDoublev( HD_CURRENT_FORCE, force.ptr() );
+  hdSetDoublev( HD_CURRENT_TORQUE, torque.ptr() );
     
-    return HD_CALLBACK_CONTINUE;
-  }
+  return HD_CALLBACK_CONTINUE;
+}
+
+void HapticDevice::runServoTick(const ServoInput& input, osg::Vec3d& force, osg::Vec3d& torque)
+{
+  // The latest matrix set by the application, never blocks.
+  // It is only valid when the application has updated the matrix
+  const WorkspaceParameters& w = m_workspace_buffer.read();
+  m_servo_loop->tick(input, w.valid ? &w.world_to_workspace : 0L, force, torque);
+}
 
 void HapticDevice::setInterpolationMode(InterpolationMode mode)
 {
 //  OpenThreads::ScopedLock<OpenThreads::Mutex> scope(m_mutex);
   m_interpolation_mode = mode;
+  updateRenderForceFilter();
+}
+
+void HapticDevice::updateRenderForceFilter()
+{
+  RenderForceFilter::Mode mode = RenderForceFilter::LINEAR;
+  switch(m_interpolation_mode) {
+    case NO_INTERPOLATION: mode = RenderForceFilter::HOLD; break;
+    case LINEAR_INTERPOLATION: mode = RenderForceFilter::LINEAR; break;
+    case CUBICAL_INTERPOLATION: mode = RenderForceFilter::CUBICAL; break;
+    case FILTER_INTERPOLATION: mode = RenderForceFilter::FILTER; break;
+  }
+
+  m_render_force_filter->setMode(mode, m_filter_coefficients);
 }
 
 
@@ -531,8 +551,8 @@ osg::Vec3 HapticDevice::RenderForce::evaluate(const RenderForce &previous_force,
   osg::Vec3 interpolated_force;
   double interval = getTimeStamp() - previous_force.getTimeStamp();
 
-  if (abs(interval) < 1E-10)
-    return osg::Vec3(0,0,0);
+  if (fabs(interval) < 1E-10)
+    return getForce();
 
   double t = (time - getTimeStamp())/interval;
 
@@ -564,11 +584,10 @@ void HapticDevice::setRenderForce(const osg::Vec3& force)
   m_previous_render_force = m_current_render_force;
   m_current_render_force.set(force, getTimeStamp());
 
-  //warning("size") << "Size : " << m_rendering_forces.size() << std::endl;
-  m_rendering_forces.push_back(force);
-  if(m_rendering_forces.size() > 10)
-    m_rendering_forces.erase(m_rendering_forces.begin());
+  m_render_force_filter->addSample(force, m_current_render_force.getTimeStamp());
 
+  // Does nothing if it is already added
+  m_servo_loop->addForceOperator(m_render_force_filter.get());
 }
 
 
@@ -592,6 +611,8 @@ void HapticDevice::initCallbacks()
                             HD_DEFAULT_SCHEDULER_PRIORITY );
   m_hd_handles.push_back( handle );
 
+  m_servo_loop->setTicking(true);
+
   handle = hdScheduleAsynchronous( HapticDevice::beginFrameCB,
                                    this,
                                    HD_MAX_SCHEDULER_PRIORITY );
@@ -737,6 +758,40 @@ void HLCALLBACK HapticDevice::buttonCallback( HLenum event,
 
 
 
+void HapticDevice::updateSimulatedButtons(int buttons)
+{
+  using namespace osgSensor;
+
+  bool down[2] = { (buttons & 1) != 0, (buttons & 2) != 0 };
+  if (down[0] == m_current_state.buttons[0] && down[1] == m_current_state.buttons[1])
+    return;
+
+  osgSensor::Sensor::EventHandlerMap event_handlers = getEventHandlers();
+  osgSensor::Sensor::EventHandlerMap::iterator it;
+
+  float time = getTime();
+
+  // Same events as buttonCallback() sends for a real device
+  for(it = event_handlers.begin(); it != event_handlers.end(); it++) 
+  {  
+    it->first->begin(this);
+    it->first->setNumberOfButtons(getNumberOfButtons());
+    it->first->setNumberOfValuators(getNumberOfValuators());
+
+    for(unsigned int i=0; i < 2; i++) {
+      if (down[i] != m_current_state.buttons[i])
+        it->first->pushEvent(time, SensorEventHandler::BUTTON, 
+          i == 0 ? SensorEventHandler::BUTTON_1 : SensorEventHandler::BUTTON_2, 
+          down[i] ? SensorEventHandler::DOWN : SensorEventHandler::UP);
+    }
+    it->first->end();
+  } // for
+
+  m_current_state.buttons[0] = down[0];
+  m_current_state.buttons[1] = down[1];
+}
+
+
 HDCallbackCode HDCALLBACK HapticDevice::DeviceDataCB( void *data ) {
   HapticDevice::DeviceState *state = static_cast< HapticDevice::DeviceState * >( data );
   HDint asd;
@@ -757,6 +812,23 @@ void HapticDevice::update(float time)
   if (!m_initialized)
     return;
 
+  if (isSimulated()) {
+    ServoInput input;
+    m_simulated_device->getState(input, m_current_state.force, m_current_state.torque);
+    m_current_state.update_rate = m_simulated_device->getUpdateRate();
+    m_current_state.transformation.set(input.transform);
+    m_current_state.velocity.set(input.velocity[0], input.velocity[1], input.velocity[2]);
+    m_current_state.angular_velocity.set(input.angular_velocity[0], input.angular_velocity[1], input.angular_velocity[2]);
+
+    // There is no HL proxy, so the proxy follows the end effector
+    osg::Matrix w2w_matrix;
+    if (getWorldToWorkSpaceMatrix(w2w_matrix))
+      m_current_state.proxy_transformation = m_current_state.transformation*osg::Matrix::inverse(w2w_matrix);
+
+    updateSimulatedButtons(input.buttons);
+    return;
+  }
+
   //--by SophiaSoo/CUHK: for two arms
   hdMakeCurrentDevice(getHandle());      
 
@@ -794,6 +866,21 @@ void HapticDevice::shutdown(float time)
   if (!m_initialized)
     return;
 
+  if (isSimulated()) {
+    m_simulated_device->stopScheduler();
+
+    m_shutting_down = true;
+    m_contact_events.clear();
+    m_force_effects.clear();
+
+    m_servo_loop->setTicking(false);
+    m_servo_loop->removeAllForceOperators();
+    m_servo_loop->stopTrace();
+
+    m_initialized = false;
+    return;
+  }
+
   makeCurrent();
 
   //--by SophiaSoo/CUHK: for two arms, unschedule process should do before m_hd_handles.clear 
@@ -808,7 +895,11 @@ void HapticDevice::shutdown(float time)
   m_hd_handles.clear();
   //m_event_handlers.clear();
   m_force_effects.clear();
-  m_force_operators.clear();
+
+  // The servo callbacks are unscheduled, so everything retired by the ServoLoop can be deleted right away
+  m_servo_loop->setTicking(false);
+  m_servo_loop->removeAllForceOperators();
+  m_servo_loop->stopTrace();
   
   
   // free up the haptic rendering context
@@ -919,17 +1010,25 @@ HDCallbackCode HDCALLBACK  HapticDevice::endFrameCB( void *data)
 
 void HapticDevice::makeCurrent()
 {
+  if (isSimulated())
+    return;
+
   hlMakeCurrent(m_hHLRContext);
 }
 
 
 void HapticDevice::makeCurrentDevice()
 {
+  if (isSimulated())
+    return;
+
 	hdMakeCurrentDevice(getHandle());
 }
 
 void HapticDevice::beginFrame()
 {
+  if (isSimulated())
+    return;
   
   makeCurrent();
 
@@ -952,6 +1051,8 @@ void HapticDevice::beginFrame()
 
 void HapticDevice::endFrame()
 {
+  if (isSimulated())
+    return;
 
   
   makeCurrent();
@@ -1040,6 +1141,11 @@ osg::Quat HapticDevice::getProxyOrientation() const
 
 void HapticDevice::setEnableForceOutput(bool f)
 {
+  if (isSimulated()) {
+    m_force_output_enabled = f;
+    return;
+  }
+
   makeCurrent();
   if (f) {
     hdEnable(HD_FORCE_OUTPUT);
@@ -1052,6 +1158,11 @@ void HapticDevice::setEnableForceOutput(bool f)
 
 void HapticDevice::setEnableForceClamping(bool f)
 {
+  if (isSimulated()) {
+    m_force_clamping_enabled = f;
+    return;
+  }
+
   makeCurrent();
   if (f) {
     hdEnable(HD_MAX_FORCE_CLAMPING);
@@ -1062,9 +1173,33 @@ void HapticDevice::setEnableForceClamping(bool f)
   m_force_clamping_enabled = f;
 }
 
+void HapticDevice::setEnableAdaptiveViewport(bool f)
+{
+  if (isSimulated()) {
+    m_adaptive_viewport_enabled = f;
+    return;
+  }
+
+  makeCurrent();
+  if (f) {
+    hlEnable(HL_ADAPTIVE_VIEWPORT);
+  }
+  else {
+    hlDisable(HL_ADAPTIVE_VIEWPORT);
+  }
+  m_adaptive_viewport_enabled = f;
+}
+
 
 void HapticDevice::getMaxWorkspace(osg::Vec3& min, osg::Vec3& max)
 {
+  // Roughly the workspace of a PHANTOM Omni
+  if (isSimulated()) {
+    min.set(-80, -60, -35);
+    max.set(80, 60, 35);
+    return;
+  }
+
   makeCurrent();
   HDdouble maxWorkspace[6];
   hdGetDoublev(HD_MAX_WORKSPACE_DIMENSIONS, maxWorkspace);
@@ -1120,27 +1255,6 @@ void HLCALLBACK HapticDevice::computeForceCB(HLcache *cache, void *userdata)
 }
 
 
-void HapticDevice::addForceOperator(ForceOperator *fo)
-{
-  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
-  m_force_operators[fo] = fo;
-}
-
-void HapticDevice::removeForceOperator(ForceOperator *fo)
-{
-  ForceOperatorMap::iterator it = m_force_operators.find(fo);
-  if (it != m_force_operators.end()) {
-    
-    if (!m_shutting_down) {
-      OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
-      m_force_operators.erase(it);
-    }
-    else
-      m_force_operators.erase(it);
-  }
-}
-
-
 void HapticDevice::unScheduleForceEffectCallback(ForceEffect *fe)
 {
   //m_scheduled_force_effect_callbacks[fe] = fe;
@@ -1493,15 +1607,8 @@ bool HapticDevice::calculateBartlettHanningWindowCoefficients(unsigned n, std::v
 bool HapticDevice::recalculateFilter()
 {
   bool f = calculateFilterCoefficients(m_filter_coefficients, m_filter_window_size, m_cutoff, m_filter_type);
-  if (f) {
-    std::ofstream of;
-    of.open("d:\\temp\asd.txt", std::ios_base::trunc);
-
-
-    for(unsigned int i=0; i < m_filter_coefficients.size(); i++) 
-      of << m_filter_coefficients[i] << std::endl;
-
-  }
+  if (f)
+    updateRenderForceFilter();
 
   return f;
 
@@ -1515,7 +1622,7 @@ bool HapticDevice::recalculateFilter()
 
 bool HapticDevice::calculateFilterCoefficients( FilterCoefficients& coefficients, unsigned int M, double cutoff, enum FilterType filter_type )
 {
-  if (M <= 0 || M > 100) {
+  if (M <= 0 || M > RenderForceFilter::MAX_TAPS) {
     osg::notify(osg::WARN) << "HapticDevice::calculateFilterCoefficients(): Invalid filter size specified" << std::endl;
     return false;
   }
@@ -1632,29 +1739,12 @@ bool HapticDevice::calculateFilterCoefficients( FilterCoefficients& coefficients
 }
 
 
-/* Filter the data with a previously computed FIR filter.
- */
-template<class T>
-T HapticDevice::filter( std::vector<T>& in_data, 
-                                FilterCoefficients& coefficients )
-{
-    unsigned int M = coefficients.size();
-
-    if (in_data.size() < M) {
-        //warning("filter") << "Unable to calculated filtered value due to few sample points" << std::endl;
-        std::cerr << "Unable to calculated filtered value due to few sample points" << std::endl;
-    }
-
-    T sum;
-    for(unsigned int i=0; i<M; i++)
-    {
-      sum += in_data[i] * coefficients[i];
-    }
-    return sum;
-}
-
 void HapticDevice::setProxyPosition(const osg::Vec3d& pos)
 {
+  // There is no HL proxy to move for a simulated device
+  if (isSimulated())
+    return;
+
   //--by SophiaSoo/CUHK: for two arms
   makeCurrent();
 
@@ -21,6 +21,8 @@
 #include <iostream>
 #include <osgHaptics/HapticRenderBin.h>
 #include <osgUtil/StateGraph>
+#include <osg/GL>
+#include <algorithm>
 
 using namespace osgHaptics;
 
@@ -117,6 +119,7 @@ void HapticRenderBin::drawImplementation(osg::RenderInfo& renderInfo,osgUtil::Re
 
   // Clear the list of already drawn drawables 
   m_rendered_shapes.clear();
+  m_num_culled_triangles.clear();
 
   // For each drawn drawable that has a haptic Shape StateAttribute attached to it,
   // store a weak reference and before rendering successive drawables, check if it has already been drawn...
@@ -219,3 +222,115 @@ void HapticRenderBin::renderHapticLeaf(osgUtil::RenderLeaf* original, osg::Rende
     m_haptic_renderleaf->set(original);
   m_haptic_renderleaf->render(renderInfo, previous);
 }
+
+
+namespace {
+
+  /// Orders triangles by the distance from their centroid to a point
+  struct CloserTo {
+    CloserTo(const std::vector<osg::Vec3>& vertices, const osg::Vec3& p) : m_vertices(vertices), m_p(p) {}
+
+    float distance2(unsigned int t) const 
+    { 
+      return ((m_vertices[3*t]+m_vertices[3*t+1]+m_vertices[3*t+2])/3.0f - m_p).length2(); 
+    }
+
+    bool operator()(unsigned int a, unsigned int b) const { return distance2(a) < distance2(b); }
+
+    const std::vector<osg::Vec3>& m_vertices;
+    osg::Vec3 m_p;
+  };
+}
+
+
+void HapticRenderBin::renderCulled(const osg::Drawable& drawable, const HapticDevice& device, const osg::Matrix& modelview,
+  osg::RenderInfo& renderInfo)
+{
+  unsigned int& num_rendered = m_num_culled_triangles[&device];
+  unsigned int max_triangles = device.getMaxCulledTriangles();
+  if (max_triangles && num_rendered >= max_triangles)
+    return;
+
+  osg::ref_ptr<TriangleSet> triangles = TriangleSet::get(drawable);
+  if (!triangles->getNumTriangles())
+    return;
+
+  // The proxy is in world coordinates, the triangles in the local coordinates of the drawable
+  osg::Matrix world_to_local = renderInfo.getState()->getInitialViewMatrix() * osg::Matrix::inverse(modelview);
+  float radius = device.getCullRadius() * getMaxStretch(world_to_local);
+
+  osg::Vec3 proxy = device.getProxyPosition();
+  osg::Vec3 center = world_to_local.preMult(proxy);
+
+  if (device.getCullLookAhead() > 0) {
+    // Cover the sphere around the proxy along the way it will move
+    osg::Vec3 ahead = world_to_local.preMult(proxy + device.getLinearVelocity()*device.getCullLookAhead());
+    osg::Vec3 r(radius, radius, radius);
+    osg::BoundingBox region;
+    region.expandBy(center-r);
+    region.expandBy(center+r);
+    region.expandBy(ahead-r);
+    region.expandBy(ahead+r);
+    triangles->getHierarchy()->query(region, m_cull_result);
+  }
+  else
+    triangles->getHierarchy()->query(center, radius, m_cull_result);
+
+  m_culled_triangles.assign(m_cull_result.size(), 0);
+  for(unsigned int i=0; i < m_cull_result.size(); i++)
+    m_culled_triangles[i] = m_cull_result[i];
+
+  // Over the budget of the frame, keep the triangles closest to the proxy
+  if (max_triangles && num_rendered+m_culled_triangles.size() > max_triangles) {
+    unsigned int n = max_triangles-num_rendered;
+    std::nth_element(m_culled_triangles.begin(), m_culled_triangles.begin()+n, m_culled_triangles.end(), 
+      CloserTo(triangles->getVertices(), center));
+    m_culled_triangles.resize(n);
+  }
+  num_rendered += m_culled_triangles.size();
+
+  if (m_culled_triangles.empty())
+    return;
+
+  // Submit all culled triangles with one glDrawElements on the vertices of the triangle set
+  m_culled_indices.resize(3*m_culled_triangles.size());
+  for(unsigned int i=0; i < m_culled_triangles.size(); i++) {
+    GLuint first = 3*m_culled_triangles[i];
+    m_culled_indices[3*i] = first;
+    m_culled_indices[3*i+1] = first+1;
+    m_culled_indices[3*i+2] = first+2;
+  }
+
+  osg::State& state = *renderInfo.getState();
+  state.unbindVertexBufferObject();
+  state.unbindElementBufferObject();
+  state.setVertexPointer(3, GL_FLOAT, 0, &triangles->getVertices().front());
+  glDrawElements(GL_TRIANGLES, (GLsizei)m_culled_indices.size(), GL_UNSIGNED_INT, &m_culled_indices.front());
+  state.disableVertexPointer();
+}
+
+
+unsigned int HapticRenderBin::selectLOD(const osg::Drawable& drawable, const TriangleSet& triangles, const HapticDevice& device, 
+  const osg::Matrix& modelview, osg::RenderInfo& renderInfo) const
+{
+  float lod_distance = device.getLODDistance();
+  if (lod_distance <= 0 || triangles.getNumLODs() < 2)
+    return 0;
+
+  // Distance from the proxy to the bounding box of drawable, measured in local coordinates and scaled back to world.
+  // Dividing by the largest stretch underestimates the world distance, so a level is never coarser than it should be
+  osg::Matrix world_to_local = renderInfo.getState()->getInitialViewMatrix() * osg::Matrix::inverse(modelview);
+  osg::Vec3 proxy = world_to_local.preMult(device.getProxyPosition());
+
+  const osg::BoundingBox& bound = drawable.getBound();
+  osg::Vec3 closest(osg::clampBetween(proxy[0], bound.xMin(), bound.xMax()), 
+    osg::clampBetween(proxy[1], bound.yMin(), bound.yMax()), 
+    osg::clampBetween(proxy[2], bound.zMin(), bound.zMax()));
+  float distance = (proxy-closest).length() / getMaxStretch(world_to_local);
+
+  // Each doubling of the distance beyond the LOD distance is one level coarser
+  unsigned int level = 0;
+  for(float d = lod_distance; distance > d && level+1 < triangles.getNumLODs(); d *= 2)
+    level++;
+  return level;
+}
@@ -20,8 +20,8 @@
 
 
 #include <osgHaptics/HapticRenderLeaf.h>
-#include <osgHaptics/RenderTriangleOperator.h>
 #include <osgHaptics/HapticRenderBin.h>
+#include <osgHaptics/TriangleSet.h>
 #include <osgHaptics/Shape.h>
 
 #include <osgUtil/StateGraph>
@@ -31,6 +31,86 @@
 using namespace osgHaptics;
 
 
+namespace {
+
+  /// Returns true if mode describes filled polygons, which are the only primitives that take part in haptic rendering
+  bool isPolygonMode(GLenum mode)
+  {
+    switch(mode) {
+      case(osg::PrimitiveSet::TRIANGLES):
+      case(osg::PrimitiveSet::TRIANGLE_STRIP):
+      case(osg::PrimitiveSet::TRIANGLE_FAN):
+      case(osg::PrimitiveSet::QUADS):
+      case(osg::PrimitiveSet::QUAD_STRIP):
+      case(osg::PrimitiveSet::POLYGON):
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /// Return the number of triangles the polygons of geometry decompose into, counted from the number of indices
+  unsigned int countTriangles(const osg::Geometry& geometry)
+  {
+    unsigned int num_triangles = 0;
+    const osg::Geometry::PrimitiveSetList& primitives = geometry.getPrimitiveSetList();
+    for(unsigned int i=0; i < primitives.size(); i++) {
+      unsigned int n = primitives[i]->getNumIndices();
+      switch(primitives[i]->getMode()) {
+        case(osg::PrimitiveSet::TRIANGLES): num_triangles += n/3; break;
+        case(osg::PrimitiveSet::QUADS): num_triangles += n/2; break;
+        case(osg::PrimitiveSet::TRIANGLE_STRIP):
+        case(osg::PrimitiveSet::TRIANGLE_FAN):
+        case(osg::PrimitiveSet::QUAD_STRIP):
+        case(osg::PrimitiveSet::POLYGON): 
+          if (n > 2) num_triangles += n-2; 
+          break;
+        default:
+          break;
+      }
+    }
+    return num_triangles;
+  }
+
+  /*!
+    Draw the polygons of geometry straight from its own vertex array, one glDrawArrays/glDrawElements 
+    per primitive set. 
+    \return false if the vertex array is not a plain Vec3Array, the caller then has to gather the triangles itself
+  */
+  bool drawVertexArrays(const osg::Geometry& geometry, osg::State& state)
+  {
+    const osg::Vec3Array *vertices = dynamic_cast<const osg::Vec3Array *>(geometry.getVertexArray());
+    if (!vertices || vertices->empty() || geometry.getVertexIndices())
+      return false;
+
+    state.unbindVertexBufferObject();
+    state.unbindElementBufferObject();
+    state.setVertexPointer(3, GL_FLOAT, 0, &vertices->front());
+
+    const osg::Geometry::PrimitiveSetList& primitives = geometry.getPrimitiveSetList();
+    for(unsigned int i=0; i < primitives.size(); i++) {
+      if (isPolygonMode(primitives[i]->getMode()))
+        primitives[i]->draw(state, false);
+    }
+
+    state.disableVertexPointer();
+    return true;
+  }
+
+  /// Draw triangles, three vertices each, with one glDrawArrays
+  void drawTriangles(const std::vector<osg::Vec3>& vertices, osg::State& state)
+  {
+    if (vertices.empty())
+      return;
+
+    state.unbindVertexBufferObject();
+    state.setVertexPointer(3, GL_FLOAT, 0, &vertices.front());
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+    state.disableVertexPointer();
+  }
+}
+
+
 
 
 void HapticRenderLeaf::render(osg::RenderInfo& renderInfo,osgUtil::RenderLeaf* previous)
@@ -90,19 +170,46 @@ void HapticRenderLeaf::render(osg::RenderInfo& renderInfo,osgUtil::RenderLeaf* p
     if (shape && !shape->getHapticDevice()->getEnableShapeRender())
       return;
 
-    if (shape && render_shape) {
-      //shape = static_cast<const osgHaptics::Shape*> (sa);
-			shape->preDraw();      
-    }
-
 #ifdef OSGUTIL_RENDERBACKEND_USE_REF_PTR
     osg::Geometry* geom = dynamic_cast<osg::Geometry *>(_drawable.get());
 #else
     osg::Geometry* geom = dynamic_cast<osg::Geometry *>(_drawable);
 #endif
-    if (geom) {
-      RenderTriangleOperator op;
-      geom->accept(op);
+    bool culled = geom && shape->getHapticDevice()->getCullRadius() > 0;
+
+    // Far from the proxy, a simplified level of the triangles is enough.
+    // A modified drawable has lost its levels, so it is not extracted again just to look for them.
+    osg::ref_ptr<TriangleSet> triangles;
+    unsigned int lod = 0;
+    if (geom && !culled && shape->getHapticDevice()->getLODDistance() > 0) {
+      triangles = TriangleSet::find(*geom);
+      if (triangles.valid())
+        lod = m_renderbin->selectLOD(*geom, *triangles, *shape->getHapticDevice(), *_modelview, renderInfo);
+    }
+
+    if (shape && render_shape) {
+      //shape = static_cast<const osgHaptics::Shape*> (sa);
+      // Only the triangles around the proxy are drawn when culling, a feedback buffer shape suits those best
+      unsigned int num_triangles = 0;
+      if (lod)
+        num_triangles = triangles->getLODVertices(lod).size()/3;
+      else if (geom && !culled)
+        num_triangles = countTriangles(*geom);
+			shape->preDraw(num_triangles);      
+    }
+
+    if (culled) {
+      m_renderbin->renderCulled(*geom, *shape->getHapticDevice(), *_modelview, renderInfo);
+    }
+    else if (lod) {
+      drawTriangles(triangles->getLODVertices(lod), *renderInfo.getState());
+    }
+    else if (geom) {
+      if (!drawVertexArrays(*geom, *renderInfo.getState())) {
+        if (!triangles.valid())
+          triangles = TriangleSet::get(*geom);
+        drawTriangles(triangles->getVertices(), *renderInfo.getState());
+      }
     }
     else
       // draw the drawable
@@ -19,6 +19,7 @@
 */
 #include <stdexcept>
 #include <osgHaptics/HapticRenderPrepareVisitor.h>
+#include <osgHaptics/TriangleSet.h>
 
 #include <osg/Object>
 #include <osg/Geode>
@@ -27,7 +28,7 @@
 using namespace osgHaptics;
 
 HapticRenderPrepareVisitor::HapticRenderPrepareVisitor(HapticDevice *device, TraversalMode tm) :
- NodeVisitor(tm), m_device(device)
+ NodeVisitor(tm), m_device(device), m_num_lods(1), m_lod_reduction(0.25f)
 {
   if (!device)
     throw std::runtime_error("HapticRenderPrepareVisitor::HapticRenderPrepareVisitor(): Device pointer is NULL!");
@@ -43,6 +44,14 @@ void HapticRenderPrepareVisitor::apply(osg::Geode& node)
   for (unsigned int i=0; i < node.getNumDrawables(); i++)
   {
     osg::Drawable *drawable = node.getDrawable(i);
+
+    // Triangulate and simplify now, so that the haptic rendering does not pay for it in the first frames.
+    // Without levels of detail the triangles are only needed for culling, which extracts them when it first needs them
+    if (m_num_lods > 1) {
+      TriangleSet *triangles = TriangleSet::get(*drawable);
+      if (triangles->getNumLODs() == 1)
+        triangles->buildLODs(m_num_lods, m_lod_reduction);
+    }
     
     osg::StateSet *ss = drawable->getOrCreateStateSet();
     // Check if there are already a shape attached to this drawable
@@ -4,7 +4,15 @@
 using namespace osgHaptics;
 
 HashedGridDrawable::HashedGridDrawable(TriangleHashGrid *grid, HapticDevice *device) : 
-  Drawable(), m_hashed_grid(grid), m_haptic_device(device), m_number_of_drawn_triangles(0)
+  Drawable(), m_hashed_grid(grid), m_haptic_device(device), m_query_radius(0), m_look_ahead(0), 
+  m_number_of_drawn_triangles(0)
+{
+  setUseDisplayList(false);
+}
+
+HashedGridDrawable::HashedGridDrawable(InstanceHashGrid *grid, TriangleInstances *instances, HapticDevice *device) : 
+  Drawable(), m_instance_grid(grid), m_instances(instances), m_haptic_device(device), m_query_radius(0), m_look_ahead(0), 
+  m_number_of_drawn_triangles(0)
 {
   setUseDisplayList(false);
 }
@@ -12,67 +20,120 @@ HashedGridDrawable::HashedGridDrawable(TriangleHashGrid *grid, HapticDevice *dev
 HashedGridDrawable::~HashedGridDrawable()
 {
   m_hashed_grid = 0L;
+  m_instance_grid = 0L;
+  m_cache = 0L;
 }
 
 
 void HashedGridDrawable::drawImplementation(osg::RenderInfo& state) const
 {
-  if (!m_haptic_device.valid() || !m_hashed_grid.valid())
+  bool use_cache = m_cache.valid() && m_cache->getHierarchy();
+  bool use_instances = !use_cache && m_instance_grid.valid() && m_instances.valid();
+  if (!m_haptic_device.valid() || (!m_hashed_grid.valid() && !use_instances && !use_cache))
     return;
 
   // Get the position of the proxydevice
   osg::Vec3 pos = m_haptic_device->getProxyPosition();
 
-  // Get all the triangles that are in proximity to the proxy device
-  TriangleHashGrid::HashVector result;
+  float radius = m_query_radius;
+  if (radius <= 0 && use_cache) {
+    osg::BoundingBox bound = m_cache->getHierarchy()->getBound();
+    radius = osg::maximum(bound.xMax()-bound.xMin(), osg::maximum(bound.yMax()-bound.yMin(), bound.zMax()-bound.zMin()))/32;
+  }
+  else if (radius <= 0) {
+    osg::Vec3 cell_size = use_instances ? m_instance_grid->getCellSize() : m_hashed_grid->getCellSize();
+    radius = osg::maximum(cell_size[0], osg::maximum(cell_size[1], cell_size[2]));
+  }
+
+  // Cover the sphere around the proxy along the way it will move during the look ahead time
+  osg::BoundingBox region;
+  osg::Vec3 r(radius, radius, radius);
+  region.expandBy(pos-r);
+  region.expandBy(pos+r);
+  if (m_look_ahead > 0) {
+    osg::Vec3 ahead = pos + m_haptic_device->getLinearVelocity()*m_look_ahead;
+    region.expandBy(ahead-r);
+    region.expandBy(ahead+r);
+  }
+
+  // Get all the triangles that are in proximity to the proxy device, each one once
   osg::Timer_t start = osg::Timer::instance()->tick();
-  bool found = m_hashed_grid->intersect(pos, result);
-  osg::Timer_t stop = osg::Timer::instance()->tick();
-  //std::cerr << "# " << result.size() << "  t: " << osg::Timer::instance()->delta_m(start,stop) << std::endl;
-  if (!found)
+  if (use_cache) {
+    const TriangleCache::Hierarchy *hierarchy = m_cache->getHierarchy();
+    if (m_look_ahead > 0)
+      hierarchy->query(region, m_cache_query_result);
+    else
+      hierarchy->query(pos, radius, m_cache_query_result);
+
+    m_number_of_drawn_triangles = m_cache_query_result.size();
+
+    // The vertices are three per triangle, possibly straight from the mapped file
+    const osg::Vec3 *vertices = m_cache->getVertices();
+    glBegin(GL_TRIANGLES);
+    for(TriangleCache::Hierarchy::QueryResult::const_iterator tit = m_cache_query_result.begin(); 
+      tit != m_cache_query_result.end(); tit++) {
+      const osg::Vec3 *v = vertices + 3*(**tit);
+      glVertex3fv(v[0].ptr());
+      glVertex3fv(v[1].ptr());
+      glVertex3fv(v[2].ptr());
+    }
+    glEnd();
     return;
+  }
 
-
-  start = osg::Timer::instance()->tick();
-  //std::cerr << "#: " << result.size() << std::endl;
-  TriangleHashGrid::HashVector::const_iterator it = result.begin();
-
-  // Make sure that triangles are rendered only once
-  // So first add them to a set, where only unique triangles are stored.
-  typedef std::set<const Triangle *> TriangleSet;
-  TriangleSet triangles;
-  // Unused variable
-  //unsigned int n=0;
-  for (; it != result.end(); it++) {
-    TriangleHashGrid::HashedDataVector::const_iterator vit = (*it)->begin();  
-  
-    for(; vit != (*it)->end(); vit++) {
-      const Triangle *t = vit->get();
-      triangles.insert(t);    
+  if (use_instances) {
+    if (m_look_ahead > 0)
+      m_instance_grid->query(region, m_instance_query_result);
+    else
+      m_instance_grid->query(pos, radius, m_instance_query_result);
+
+    m_number_of_drawn_triangles = m_instance_query_result.size();
+
+    // The triangles are shared between instances, transform them when rendered
+    osg::Vec3 v1, v2, v3;
+    glBegin(GL_TRIANGLES);
+    for(InstanceHashGrid::QueryResult::const_iterator tit = m_instance_query_result.begin(); 
+      tit != m_instance_query_result.end(); tit++) {
+      m_instances->getTriangle(**tit, v1, v2, v3);
+      glVertex3fv(v1.ptr());
+      glVertex3fv(v2.ptr());
+      glVertex3fv(v3.ptr());
     }
+    glEnd();
+    return;
   }
 
-  // Now render the triangles
-  TriangleSet::const_iterator tit = triangles.begin();
-  m_number_of_drawn_triangles = triangles.size();
+  if (m_look_ahead > 0)
+    m_hashed_grid->query(region, m_query_result);
+  else
+    m_hashed_grid->query(pos, radius, m_query_result);
+  osg::Timer_t stop = osg::Timer::instance()->tick();
+  //std::cerr << "# " << m_query_result.size() << "  t: " << osg::Timer::instance()->delta_m(start,stop) << std::endl;
 
-  glBegin(GL_TRIANGLES);
-  for(; tit != triangles.end(); tit++) {
+  m_number_of_drawn_triangles = m_query_result.size();
+  if (m_query_result.empty())
+    return;
 
-    glVertex3fv((*tit)->m_p1.ptr());
-    glVertex3fv((*tit)->m_p2.ptr());
-    glVertex3fv((*tit)->m_p3.ptr());
+  // Now render the triangles
+  glBegin(GL_TRIANGLES);
+  for(TriangleHashGrid::QueryResult::const_iterator tit = m_query_result.begin(); tit != m_query_result.end(); tit++) {
+    const Triangle *t = (*tit)->get();
+    glVertex3fv(t->m_p1.ptr());
+    glVertex3fv(t->m_p2.ptr());
+    glVertex3fv(t->m_p3.ptr());
   }
   glEnd();
-
-  //n = triangles.size();
-  stop = osg::Timer::instance()->tick();
-  //std::cerr << "Draw #: " << n <<  "  t: " << osg::Timer::instance()->delta_m(start,stop) << std::endl;
 }
 
 
 osg::BoundingBox HashedGridDrawable::computeBound() const
 {
+  if (m_cache.valid() && m_cache->getHierarchy())
+    return m_cache->getHierarchy()->getBound();
+
+  if (m_instance_grid.valid())
+    return m_instance_grid->getBound();
+
   osg::BoundingBox bbox = m_hashed_grid->getBound();
   return bbox;
 }
@@ -0,0 +1,403 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+
+#include <osgHaptics/MeshDecimator.h>
+#include <osg/Vec3d>
+#include <map>
+#include <queue>
+#include <algorithm>
+#include <iterator>
+#include <math.h>
+
+using namespace osgHaptics;
+
+namespace {
+
+  /// The symmetric 4x4 matrix of a sum of squared distances to planes
+  struct Quadric {
+    Quadric() { for(unsigned int i=0; i < 10; i++) a[i] = 0; }
+
+    /// The squared distance to the plane n.p+d=0 times weight, n normalized
+    Quadric(const osg::Vec3d& n, double d, double weight)
+    {
+      a[0] = n[0]*n[0]; a[1] = n[0]*n[1]; a[2] = n[0]*n[2]; a[3] = n[0]*d;
+      a[4] = n[1]*n[1]; a[5] = n[1]*n[2]; a[6] = n[1]*d;
+      a[7] = n[2]*n[2]; a[8] = n[2]*d;
+      a[9] = d*d;
+      for(unsigned int i=0; i < 10; i++) a[i] *= weight;
+    }
+
+    Quadric& operator+=(const Quadric& q) 
+    { 
+      for(unsigned int i=0; i < 10; i++) a[i] += q.a[i]; 
+      return *this; 
+    }
+
+    double error(const osg::Vec3d& p) const
+    {
+      double x = p[0], y = p[1], z = p[2];
+      return a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x 
+        + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y 
+        + a[7]*z*z + 2*a[8]*z + a[9];
+    }
+
+    /// Find the position with the smallest error, returns false if it is not unique
+    bool minimum(osg::Vec3d& p) const
+    {
+      // Solve the symmetric system A p = -b by Cramer's rule
+      double c0 = a[4]*a[7]-a[5]*a[5], c1 = a[2]*a[5]-a[1]*a[7], c2 = a[1]*a[5]-a[2]*a[4];
+      double det = a[0]*c0 + a[1]*c1 + a[2]*c2;
+      double scale = a[0]+a[4]+a[7];
+      if (scale <= 0 || fabs(det) <= 1e-9*scale*scale*scale)
+        return false;
+
+      double b0 = -a[3], b1 = -a[6], b2 = -a[8];
+      p[0] = (b0*c0 + b1*c1 + b2*c2) / det;
+      p[1] = (b0*c1 + b1*(a[0]*a[7]-a[2]*a[2]) + b2*(a[1]*a[2]-a[0]*a[5])) / det;
+      p[2] = (b0*c2 + b1*(a[1]*a[2]-a[0]*a[5]) + b2*(a[0]*a[4]-a[1]*a[1])) / det;
+      return true;
+    }
+
+    double a[10];
+  };
+
+  struct Vertex {
+    Vertex() : version(0), removed(false) {}
+
+    osg::Vec3d position;
+    Quadric quadric;
+
+    /// The triangles using this vertex, possibly some removed ones
+    std::vector<unsigned int> triangles;
+    unsigned int version;
+    bool removed;
+  };
+
+  struct Triangle {
+    unsigned int v[3];
+    bool removed;
+
+    bool contains(unsigned int vertex) const { return v[0]==vertex || v[1]==vertex || v[2]==vertex; }
+  };
+
+  /// A possible collapse of the edge v0-v1 into position, valid while both vertices have the same versions
+  struct Collapse {
+    double cost;
+    unsigned int v0, v1;
+    unsigned int version0, version1;
+    osg::Vec3d position;
+
+    /// Makes the priority queue return the cheapest first
+    bool operator<(const Collapse& c) const { return cost > c.cost; }
+  };
+
+  osg::Vec3d normal(const osg::Vec3d& p0, const osg::Vec3d& p1, const osg::Vec3d& p2)
+  {
+    return (p1-p0)^(p2-p0);
+  }
+
+  class Decimation {
+  public:
+    Decimation(const std::vector<osg::Vec3>& vertices, double boundary_weight);
+
+    void run(unsigned int num_triangles);
+
+    unsigned int getResult(std::vector<osg::Vec3>& result) const;
+
+  private:
+    void addCollapse(unsigned int v0, unsigned int v1);
+
+    /// Returns true if moving the vertices of the edge v0-v1 to p keeps the surface around them intact
+    bool isValid(unsigned int v0, unsigned int v1, const osg::Vec3d& p) const;
+
+    bool moveKeepsTriangles(unsigned int v, unsigned int other, const osg::Vec3d& p) const;
+
+    void collapse(const Collapse& c);
+
+    void getNeighbours(unsigned int v, std::vector<unsigned int>& neighbours) const;
+
+    std::vector<Vertex> m_vertices;
+    std::vector<Triangle> m_triangles;
+    unsigned int m_num_triangles;
+    std::priority_queue<Collapse> m_queue;
+  };
+
+
+  Decimation::Decimation(const std::vector<osg::Vec3>& vertices, double boundary_weight) : m_num_triangles(0)
+  {
+    // Weld vertices at the same position
+    std::map<osg::Vec3, unsigned int> indices;
+    for(unsigned int i=0; i+2 < vertices.size(); i+=3) {
+      Triangle t;
+      t.removed = false;
+      for(unsigned int j=0; j < 3; j++) {
+        std::map<osg::Vec3, unsigned int>::iterator it = indices.find(vertices[i+j]);
+        if (it == indices.end()) {
+          it = indices.insert(std::make_pair(vertices[i+j], (unsigned int)m_vertices.size())).first;
+          m_vertices.push_back(Vertex());
+          m_vertices.back().position = vertices[i+j];
+        }
+        t.v[j] = it->second;
+      }
+
+      if (t.v[0]==t.v[1] || t.v[1]==t.v[2] || t.v[0]==t.v[2])
+        continue;
+
+      for(unsigned int j=0; j < 3; j++)
+        m_vertices[t.v[j]].triangles.push_back(m_triangles.size());
+      m_triangles.push_back(t);
+    }
+    m_num_triangles = m_triangles.size();
+
+    // Each vertex starts with the planes of its triangles, weighted by their area
+    typedef std::map<std::pair<unsigned int, unsigned int>, unsigned int> EdgeMap;
+    EdgeMap edges;
+    for(unsigned int i=0; i < m_triangles.size(); i++) {
+      const Triangle& t = m_triangles[i];
+      osg::Vec3d n = normal(m_vertices[t.v[0]].position, m_vertices[t.v[1]].position, m_vertices[t.v[2]].position);
+      double area = n.normalize()/2;
+      Quadric q(n, -(n*m_vertices[t.v[0]].position), area);
+      for(unsigned int j=0; j < 3; j++) {
+        m_vertices[t.v[j]].quadric += q;
+
+        unsigned int a = t.v[j], b = t.v[(j+1)%3];
+        edges[std::make_pair(osg::minimum(a,b), osg::maximum(a,b))] = i;
+      }
+    }
+
+    // Count the triangles of each edge, the ones with only one are on a boundary
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> counts;
+    for(unsigned int i=0; i < m_triangles.size(); i++) {
+      const Triangle& t = m_triangles[i];
+      for(unsigned int j=0; j < 3; j++) {
+        unsigned int a = t.v[j], b = t.v[(j+1)%3];
+        counts[std::make_pair(osg::minimum(a,b), osg::maximum(a,b))]++;
+      }
+    }
+
+    for(EdgeMap::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+      if (boundary_weight > 0 && counts[it->first] == 1) {
+        // Keep the boundary in place with a plane through the edge, perpendicular to its triangle
+        const Triangle& t = m_triangles[it->second];
+        const osg::Vec3d& p0 = m_vertices[it->first.first].position;
+        const osg::Vec3d& p1 = m_vertices[it->first.second].position;
+        osg::Vec3d edge = p1-p0;
+        osg::Vec3d n = edge ^ normal(m_vertices[t.v[0]].position, m_vertices[t.v[1]].position, m_vertices[t.v[2]].position);
+        if (n.normalize() > 0) {
+          Quadric q(n, -(n*p0), boundary_weight*edge.length2());
+          m_vertices[it->first.first].quadric += q;
+          m_vertices[it->first.second].quadric += q;
+        }
+      }
+      addCollapse(it->first.first, it->first.second);
+    }
+  }
+
+
+  void Decimation::addCollapse(unsigned int v0, unsigned int v1)
+  {
+    const Vertex& a = m_vertices[v0];
+    const Vertex& b = m_vertices[v1];
+
+    Quadric q = a.quadric;
+    q += b.quadric;
+
+    Collapse c;
+    c.v0 = v0;
+    c.v1 = v1;
+    c.version0 = a.version;
+    c.version1 = b.version;
+
+    // The optimal position if there is one, otherwise the best of the end points and the midpoint
+    if (q.minimum(c.position))
+      c.cost = q.error(c.position);
+    else {
+      osg::Vec3d candidates[3] = { a.position, b.position, (a.position+b.position)*0.5 };
+      c.cost = -1;
+      for(unsigned int i=0; i < 3; i++) {
+        double cost = q.error(candidates[i]);
+        if (c.cost < 0 || cost < c.cost) {
+          c.cost = cost;
+          c.position = candidates[i];
+        }
+      }
+    }
+
+    m_queue.push(c);
+  }
+
+
+  void Decimation::getNeighbours(unsigned int v, std::vector<unsigned int>& neighbours) const
+  {
+    neighbours.clear();
+    const std::vector<unsigned int>& triangles = m_vertices[v].triangles;
+    for(unsigned int i=0; i < triangles.size(); i++) {
+      const Triangle& t = m_triangles[triangles[i]];
+      if (t.removed)
+        continue;
+      for(unsigned int j=0; j < 3; j++)
+        if (t.v[j] != v)
+          neighbours.push_back(t.v[j]);
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+  }
+
+
+  bool Decimation::moveKeepsTriangles(unsigned int v, unsigned int other, const osg::Vec3d& p) const
+  {
+    const std::vector<unsigned int>& triangles = m_vertices[v].triangles;
+    for(unsigned int i=0; i < triangles.size(); i++) {
+      const Triangle& t = m_triangles[triangles[i]];
+      // The triangles of the edge itself disappear
+      if (t.removed || t.contains(other))
+        continue;
+
+      osg::Vec3d p0 = m_vertices[t.v[0]].position, p1 = m_vertices[t.v[1]].position, p2 = m_vertices[t.v[2]].position;
+      osg::Vec3d before = normal(p0, p1, p2);
+      if (t.v[0] == v) p0 = p;
+      else if (t.v[1] == v) p1 = p;
+      else p2 = p;
+      osg::Vec3d after = normal(p0, p1, p2);
+
+      // Flipped, or turned close to edge on
+      if (before*after <= 0.2*before.length()*after.length())
+        return false;
+    }
+    return true;
+  }
+
+
+  bool Decimation::isValid(unsigned int v0, unsigned int v1, const osg::Vec3d& p) const
+  {
+    // The vertices may only share the neighbours opposite the edge, or the surface is pinched
+    std::vector<unsigned int> n0, n1, shared;
+    getNeighbours(v0, n0);
+    getNeighbours(v1, n1);
+    std::set_intersection(n0.begin(), n0.end(), n1.begin(), n1.end(), std::back_inserter(shared));
+
+    unsigned int edge_triangles = 0;
+    const std::vector<unsigned int>& triangles = m_vertices[v0].triangles;
+    for(unsigned int i=0; i < triangles.size(); i++)
+      if (!m_triangles[triangles[i]].removed && m_triangles[triangles[i]].contains(v1))
+        edge_triangles++;
+
+    if (shared.size() != edge_triangles)
+      return false;
+
+    // Collapsing a tetrahedron or a lone pair of triangles leaves nothing but degenerate triangles
+    if (n0.size() + n1.size() - shared.size() - 2 < 3)
+      return false;
+
+    return moveKeepsTriangles(v0, v1, p) && moveKeepsTriangles(v1, v0, p);
+  }
+
+
+  void Decimation::collapse(const Collapse& c)
+  {
+    Vertex& a = m_vertices[c.v0];
+    Vertex& b = m_vertices[c.v1];
+
+    // The triangles of the edge are removed, the others of v1 move over to v0
+    std::vector<unsigned int> triangles;
+    for(unsigned int i=0; i < a.triangles.size(); i++) {
+      Triangle& t = m_triangles[a.triangles[i]];
+      if (t.removed)
+        continue;
+      if (t.contains(c.v1)) {
+        t.removed = true;
+        m_num_triangles--;
+      }
+      else
+        triangles.push_back(a.triangles[i]);
+    }
+    for(unsigned int i=0; i < b.triangles.size(); i++) {
+      Triangle& t = m_triangles[b.triangles[i]];
+      if (t.removed)
+        continue;
+      for(unsigned int j=0; j < 3; j++)
+        if (t.v[j] == c.v1)
+          t.v[j] = c.v0;
+      triangles.push_back(b.triangles[i]);
+    }
+
+    a.triangles.swap(triangles);
+    a.position = c.position;
+    a.quadric += b.quadric;
+    a.version++;
+
+    b.removed = true;
+    b.triangles.clear();
+
+    std::vector<unsigned int> neighbours;
+    getNeighbours(c.v0, neighbours);
+    for(unsigned int i=0; i < neighbours.size(); i++)
+      addCollapse(c.v0, neighbours[i]);
+  }
+
+
+  void Decimation::run(unsigned int num_triangles)
+  {
+    while(m_num_triangles > num_triangles && !m_queue.empty()) {
+      Collapse c = m_queue.top();
+      m_queue.pop();
+
+      // Skip collapses computed before one of the vertices moved
+      const Vertex& a = m_vertices[c.v0];
+      const Vertex& b = m_vertices[c.v1];
+      if (a.removed || b.removed || a.version != c.version0 || b.version != c.version1)
+        continue;
+
+      if (isValid(c.v0, c.v1, c.position))
+        collapse(c);
+    }
+  }
+
+
+  unsigned int Decimation::getResult(std::vector<osg::Vec3>& result) const
+  {
+    result.clear();
+    result.reserve(3*m_num_triangles);
+    for(unsigned int i=0; i < m_triangles.size(); i++) {
+      const Triangle& t = m_triangles[i];
+      if (t.removed)
+        continue;
+      for(unsigned int j=0; j < 3; j++)
+        result.push_back(m_vertices[t.v[j]].position);
+    }
+    return result.size()/3;
+  }
+}
+
+
+MeshDecimator::MeshDecimator() : m_boundary_weight(1000)
+{
+}
+
+
+unsigned int MeshDecimator::decimate(const std::vector<osg::Vec3>& vertices, unsigned int num_triangles, 
+  std::vector<osg::Vec3>& result) const
+{
+  Decimation decimation(vertices, m_boundary_weight);
+  decimation.run(num_triangles);
+  return decimation.getResult(result);
+}
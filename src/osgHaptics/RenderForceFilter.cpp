@@ -0,0 +1,138 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+
+#include <osgHaptics/RenderForceFilter.h>
+#include <vrutils/math.h>
+#include <OpenThreads/ScopedLock>
+#include <math.h>
+
+using namespace osgHaptics;
+
+/// Unrolled dot product of n elements
+static inline double dot(const double *a, const double *b, unsigned int n)
+{
+  double s0=0, s1=0, s2=0, s3=0;
+  unsigned int i=0;
+  for(; i+4 <= n; i+=4) {
+    s0 += a[i]*b[i];
+    s1 += a[i+1]*b[i+1];
+    s2 += a[i+2]*b[i+2];
+    s3 += a[i+3]*b[i+3];
+  }
+  for(; i < n; i++)
+    s0 += a[i]*b[i];
+
+  return (s0+s1)+(s2+s3);
+}
+
+
+RenderForceFilter::RenderForceFilter() : ForceOperator(), m_sample_serial(0), m_history_pos(0)
+{
+  for(unsigned int i=0; i < 2*MAX_TAPS; i++)
+    m_history_x[i] = m_history_y[i] = m_history_z[i] = 0;
+}
+
+void RenderForceFilter::addSample(const osg::Vec3d& force, double time)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  m_sample.force = force;
+  m_sample.time = time;
+  m_sample.serial++;
+  m_sample_buffer.write(m_sample);
+}
+
+void RenderForceFilter::setMode(Mode mode, const std::vector<double>& coefficients)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  m_parameters.mode = mode;
+  m_parameters.num_taps = vrutils::min((unsigned int)coefficients.size(), (unsigned int)MAX_TAPS);
+
+  // Normalize to unit gain, so that a constant force passes unchanged
+  double sum = 0;
+  for(unsigned int i=0; i < m_parameters.num_taps; i++)
+    sum += coefficients[i];
+  if (fabs(sum) < 1E-10)
+    sum = 1;
+
+  for(unsigned int i=0; i < m_parameters.num_taps; i++)
+    m_parameters.taps[i] = coefficients[i]/sum;
+
+  m_parameter_buffer.write(m_parameters);
+}
+
+osg::Vec3d RenderForceFilter::filter(const Parameters& p, const osg::Vec3d& force)
+{
+  m_history_pos = (m_history_pos+1) % MAX_TAPS;
+  m_history_x[m_history_pos] = m_history_x[m_history_pos+MAX_TAPS] = force.x();
+  m_history_y[m_history_pos] = m_history_y[m_history_pos+MAX_TAPS] = force.y();
+  m_history_z[m_history_pos] = m_history_z[m_history_pos+MAX_TAPS] = force.z();
+
+  if (!p.num_taps)
+    return force;
+
+  unsigned int start = m_history_pos+MAX_TAPS+1-p.num_taps;
+  return osg::Vec3d(
+    dot(m_history_x+start, p.taps, p.num_taps),
+    dot(m_history_y+start, p.taps, p.num_taps),
+    dot(m_history_z+start, p.taps, p.num_taps));
+}
+
+void RenderForceFilter::calculateForce(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out)
+{
+  // A new sample from the application?
+  const Sample& s = m_sample_buffer.read();
+  if (s.serial != m_sample_serial) {
+    m_sample_serial = s.serial;
+    m_previous = m_current;
+    m_current = s;
+
+    // Nothing to interpolate from for the first sample
+    if (m_previous.serial == 0)
+      m_previous = m_current;
+  }
+
+  const Parameters& p = m_parameter_buffer.read();
+
+  // Interpolate over the interval following the latest sample, one sample behind the application
+  osg::Vec3d force;
+  double interval = m_current.time - m_previous.time;
+  if (p.mode == HOLD || interval < 1E-10)
+    force = m_current.force;
+  else {
+    double t = (frame.time - m_current.time)/interval;
+    if (p.mode == CUBICAL)
+      t = vrutils::smoothstep<double>(0, 1, t);
+    force = vrutils::mix(m_previous.force, m_current.force, t);
+  }
+
+  // The history is updated every tick so that it is sampled at the servo rate
+  osg::Vec3d filtered = filter(p, force);
+  if (p.mode == FILTER)
+    force = filtered;
+
+  // Rotate into workspace coordinates
+  osg::Quat q;
+  q.set(frame.world_to_workspace);
+  osg::Matrix m;
+  m.set(q);
+  out = m.preMult(force);
+}
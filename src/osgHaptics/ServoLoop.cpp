@@ -0,0 +1,326 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/ServoLoop.h>
+#include <osg/Notify>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+#include <sstream>
+#include <math.h>
+
+using namespace osgHaptics;
+
+/// Return the number of nanoseconds between two timer ticks, saturated to fit in an unsigned int
+static inline unsigned int deltaNanoseconds(osg::Timer_t start, osg::Timer_t end)
+{
+  double ns = osg::Timer::instance()->delta_u(start, end)*1000.0;
+  if (ns <= 0)
+    return 0;
+  if (ns >= 4294967295.0)
+    return 4294967295u;
+  return (unsigned int)ns;
+}
+
+/// Scale v down to max_length if it is longer, max_length=0 means no limit
+static inline void clampLength(osg::Vec3d& v, double max_length)
+{
+  double l2 = v.length2();
+  if (max_length > 0 && l2 > max_length*max_length)
+    v *= max_length/sqrt(l2);
+}
+
+
+ServoLoop::ServoLoop() : m_max_force(0), m_previous_tick_start(0), m_force_model_worker(0L)
+{
+}
+
+ServoLoop::~ServoLoop()
+{
+  setTicking(false);
+  removeAllForceOperators();
+  stopTrace();
+}
+
+void ServoLoop::tick(const ServoInput& input, const osg::Matrix *world_to_workspace, osg::Vec3d& force, osg::Vec3d& torque)
+{
+  osg::Timer *timer = osg::Timer::instance();
+  osg::Timer_t tick_start = timer->tick();
+  if (m_previous_tick_start)
+    m_servo_statistics.m_tick_period.record(deltaNanoseconds(m_previous_tick_start, tick_start));
+  m_previous_tick_start = tick_start;
+
+  force.set(input.force[0], input.force[1], input.force[2]);
+  torque.set(input.torque[0], input.torque[1], input.torque[2]);
+
+  // Get the currently published set of ForceOperators. It is never modified after being published,
+  // so it can be traversed without any locking.
+  const ForceOperatorSnapshot *snapshot = static_cast<const ForceOperatorSnapshot *>(m_fo_snapshot.get());
+
+  // world_to_workspace is only valid when the application has updated the matrix
+  unsigned int num_operators = 0;
+  if (world_to_workspace && snapshot) {
+
+    // Build the frame once, all ForceOperators share it
+    m_frame.set(input, m_tick_count);
+
+    // Usually the same matrix every tick, avoid the inverse then
+    if (*world_to_workspace != m_frame.world_to_workspace) {
+      m_frame.world_to_workspace = *world_to_workspace;
+      m_frame.workspace_to_world.invert(*world_to_workspace);
+    }
+
+    // Iterate over all ForceOperators and add the force together
+    ForceOperatorSnapshot::const_iterator it=snapshot->begin();
+    for(;it != snapshot->end(); it++) {
+      ForceOperator *fo = it->get();
+      fo->update();
+
+      if (fo->getEnable()) {
+        num_operators++;
+        osg::Timer_t fo_start = timer->tick();
+        osg::Vec3d out;
+        if (fo->getEvaluationRate() > 0) {
+          // Evaluated by the ForceModelWorker, extrapolate its latest model.
+          // No force until the worker has evaluated it at a real frame
+          const LocalForceModel& model = fo->m_force_model.read();
+          if (model.valid) {
+            out = model.getForce(m_frame.position);
+            clampLength(out, m_max_force);
+            force += out;
+            torque += model.torque;
+          }
+        }
+        else {
+          fo->calculateForce(m_frame, force, out);
+          clampLength(out, m_max_force);
+          force += out;
+          fo->calculateTorque(m_frame, torque, out);
+          torque += out;
+        }
+        fo->m_cost_histogram.record(deltaNanoseconds(fo_start, timer->tick()));
+      }
+    } // for
+
+    m_frame.input = 0L;
+
+    if (snapshot->multi_rate)
+      m_worker_frames.write(m_frame);
+  } // if world_to_workspace
+
+  clampLength(force, m_max_force);
+
+  // Hand the state of this tick over to the trace writer thread, if we are tracing
+  ServoTraceWriter *trace_writer = static_cast<ServoTraceWriter *>(m_trace_writer.get());
+  if (trace_writer) {
+    TraceRecord record;
+    record.input = input;
+    record.flags = 0;
+    if (world_to_workspace) {
+      record.flags |= TraceRecord::VALID_WORLD_TO_WORKSPACE;
+      for(unsigned int i=0; i < 16; i++)
+        record.world_to_workspace[i] = world_to_workspace->ptr()[i];
+    }
+    for(unsigned int i=0; i < 3; i++) {
+      record.force[i] = force[i];
+      record.torque[i] = torque[i];
+    }
+    record.num_operators = num_operators;
+    record.tick = m_tick_count;
+    record.pad = 0;
+    trace_writer->push(record);
+  }
+
+  // Done with the snapshot and the trace writer, anything retired before this point can now be deleted
+  ++m_tick_count;
+
+  m_servo_statistics.m_tick_duration.record(deltaNanoseconds(tick_start, timer->tick()));
+}
+
+void ServoLoop::setTicking(bool flag)
+{
+  m_ticking.exchange(flag ? 1 : 0);
+
+  // Nothing can reference the retired snapshots anymore
+  if (!flag) {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
+    reclaimForceOperatorSnapshots(true);
+  }
+}
+
+void ServoLoop::addForceOperator(ForceOperator *fo)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
+  if (m_force_operators.find(fo) != m_force_operators.end())
+    return;
+
+  m_force_operators[fo] = fo;
+
+  if (fo->getEvaluationRate() > 0) {
+    if (!m_force_model_worker)
+      m_force_model_worker = new ForceModelWorker(&m_worker_frames);
+    m_force_model_worker->addForceOperator(fo);
+  }
+
+  publishForceOperators();
+}
+
+void ServoLoop::removeForceOperator(ForceOperator *fo)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
+  ForceOperatorMap::iterator it = m_force_operators.find(fo);
+  if (it != m_force_operators.end()) {
+    if (m_force_model_worker)
+      m_force_model_worker->removeForceOperator(fo);
+
+    m_force_operators.erase(it);
+    publishForceOperators();
+  }
+}
+
+void ServoLoop::removeAllForceOperators()
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
+
+  // The worker only reads m_worker_frames, which is owned by us, so it can be deleted right away
+  if (m_force_model_worker) {
+    m_force_model_worker->close();
+    delete m_force_model_worker;
+    m_force_model_worker = 0L;
+  }
+
+  m_force_operators.clear();
+  publishForceOperators();
+}
+
+void ServoLoop::publishForceOperators()
+{
+  ForceOperatorSnapshot *snapshot = 0L;
+
+  // Publish a null snapshot when empty, tick() can then skip the whole thing
+  if (!m_force_operators.empty()) {
+    snapshot = new ForceOperatorSnapshot;
+    snapshot->reserve(m_force_operators.size());
+
+    ForceOperatorMap::const_iterator it = m_force_operators.begin();
+    for(; it != m_force_operators.end(); it++) {
+      snapshot->push_back(it->second);
+      if (it->second->getEvaluationRate() > 0)
+        snapshot->multi_rate = true;
+    }
+  }
+
+  // Only one writer at a time (m_fo_mutex), so the swap can not fail
+  ForceOperatorSnapshot *previous = static_cast<ForceOperatorSnapshot *>(m_fo_snapshot.get());
+  m_fo_snapshot.assign(snapshot, previous);
+
+  if (previous) {
+    // tick() might still be iterating over previous. Tag it with the current tick,
+    // it is safe to delete it as soon as the tick counter has moved on.
+    previous->retired_tick = m_tick_count;
+    m_retired_fo_snapshots.push_back(previous);
+  }
+
+  // When nothing is calling tick(), nobody can be using the retired snapshots
+  reclaimForceOperatorSnapshots(m_ticking == 0);
+}
+
+void ServoLoop::reclaimForceOperatorSnapshots(bool all)
+{
+  unsigned int tick = m_tick_count;
+
+  ForceOperatorSnapshotVector::iterator it = m_retired_fo_snapshots.begin();
+  while(it != m_retired_fo_snapshots.end()) {
+    if (all || (*it)->retired_tick != tick) {
+      delete *it;
+      it = m_retired_fo_snapshots.erase(it);
+    }
+    else
+      it++;
+  }
+}
+
+void ServoLoop::resetServoStatistics()
+{
+  m_servo_statistics.reset();
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
+  ForceOperatorMap::iterator it = m_force_operators.begin();
+  for(; it != m_force_operators.end(); it++)
+    it->second->resetCostHistogram();
+}
+
+void ServoLoop::printServoStatistics(std::ostream& os)
+{
+  m_servo_statistics.print(os);
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_fo_mutex);
+  ForceOperatorMap::iterator it = m_force_operators.begin();
+  for(unsigned int i=0; it != m_force_operators.end(); it++, i++) {
+    std::ostringstream name;
+    name << "ForceOperator " << i << " (" << it->first << ")";
+    it->second->getCostHistogram().print(os, name.str());
+  }
+}
+
+bool ServoLoop::startTrace(const std::string& filename, unsigned int buffer_size)
+{
+  stopTrace();
+
+  ServoTraceWriter *writer = new ServoTraceWriter(filename, buffer_size);
+  if (!writer->isOpen()) {
+    delete writer;
+    return false;
+  }
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_trace_mutex);
+  m_trace_writer.assign(writer, 0L);
+  return true;
+}
+
+void ServoLoop::stopTrace()
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_trace_mutex);
+
+  ServoTraceWriter *writer = static_cast<ServoTraceWriter *>(m_trace_writer.get());
+  if (!writer)
+    return;
+
+  m_trace_writer.assign(0L, writer);
+
+  // tick() might be pushing a record right now, wait until it has finished.
+  bool tick_done = true;
+  if (m_ticking) {
+    unsigned int tick = m_tick_count;
+    tick_done = false;
+    for(unsigned int i=0; i < 1000 && !tick_done; i++) {
+      OpenThreads::Thread::microSleep(1000);
+      tick_done = tick != unsigned(m_tick_count);
+    }
+  }
+
+  // Pushing to a closed writer is harmless, so it can always be closed
+  writer->close();
+
+  if (tick_done)
+    delete writer;
+  else
+    osg::notify(osg::WARN) << "ServoLoop::stopTrace(): tick() is not called anymore, the trace writer will not be deallocated" << std::endl;
+}
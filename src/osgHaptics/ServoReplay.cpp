@@ -0,0 +1,81 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/ServoReplay.h>
+#include <osg/Timer>
+#include <osg/Notify>
+
+using namespace osgHaptics;
+
+ServoReplay::ServoReplay(ServoLoop *loop) : m_servo_loop(loop), m_max_force_deviation(0)
+{
+}
+
+bool ServoReplay::open(const std::string& filename)
+{
+  m_records.clear();
+
+  ServoTraceReader reader;
+  if (!reader.open(filename))
+    return false;
+
+  TraceRecord record;
+  while (reader.read(record))
+    m_records.push_back(record);
+
+  if (m_records.empty()) {
+    osg::notify(osg::WARN) << "ServoReplay::open(): " << filename << " does not contain any ticks" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+double ServoReplay::run(unsigned int repetitions)
+{
+  m_max_force_deviation = 0;
+  m_servo_loop->setTicking(true);
+
+  osg::Timer_t start = osg::Timer::instance()->tick();
+
+  osg::Vec3d force, torque;
+  for(unsigned int r=0; r < repetitions; r++) {
+    std::vector<TraceRecord>::const_iterator it = m_records.begin();
+    for(; it != m_records.end(); it++) {
+      osg::Matrix w2w_matrix;
+      bool is_valid = (it->flags & TraceRecord::VALID_WORLD_TO_WORKSPACE) != 0;
+      if (is_valid)
+        w2w_matrix.set(it->world_to_workspace);
+
+      m_servo_loop->tick(it->input, is_valid ? &w2w_matrix : 0L, force, torque);
+
+      osg::Vec3d recorded_force(it->force[0], it->force[1], it->force[2]);
+      double deviation = (force - recorded_force).length();
+      if (deviation > m_max_force_deviation)
+        m_max_force_deviation = deviation;
+    }
+  }
+
+  double elapsed = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+  m_servo_loop->setTicking(false);
+
+  return elapsed;
+}
@@ -0,0 +1,84 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/ServoStatistics.h>
+
+using namespace osgHaptics;
+
+double TimingHistogram::binUpperBound(unsigned int i)
+{
+  if (i < SUB_BINS)
+    return i;
+
+  unsigned int shift = (i-SUB_BINS)/SUB_BINS;
+  unsigned int sub = (i-SUB_BINS)%SUB_BINS;
+
+  // The bin holds values [(SUB_BINS+sub) << shift, (SUB_BINS+sub+1) << shift)
+  return double(SUB_BINS+sub+1)*double(1u << shift) - 1.0;
+}
+
+double TimingHistogram::getPercentile(double p) const
+{
+  // Take a copy of the bins so the total is consistent with the bins we are summing up
+  unsigned int bins[NUM_BINS];
+  double total = 0;
+  for(unsigned int i=0; i < NUM_BINS; i++) {
+    bins[i] = m_bins[i];
+    total += bins[i];
+  }
+
+  if (total == 0)
+    return 0;
+
+  double rank = p*total;
+  double sum = 0;
+  for(unsigned int i=0; i < NUM_BINS; i++) {
+    sum += bins[i];
+    if (sum >= rank && bins[i]) {
+      // Never report more than the largest value actually seen
+      double value = binUpperBound(i)*0.001;
+      return value < getMax() ? value : getMax();
+    }
+  }
+  return getMax();
+}
+
+void TimingHistogram::reset()
+{
+  for(unsigned int i=0; i < NUM_BINS; i++)
+    m_bins[i].exchange(0);
+  m_count.exchange(0);
+  m_max.exchange(0);
+}
+
+void TimingHistogram::print(std::ostream& os, const std::string& name) const
+{
+  os << name << ": n=" << getCount() 
+    << " p50=" << getPercentile(0.5) << "us" 
+    << " p99=" << getPercentile(0.99) << "us" 
+    << " max=" << getMax() << "us" << std::endl;
+}
+
+void ServoStatistics::print(std::ostream& os) const
+{
+  m_tick_duration.print(os, "Servo tick duration");
+  m_tick_period.print(os, "Servo tick period");
+}
@@ -0,0 +1,197 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/ServoTrace.h>
+#include <osg/Notify>
+#include <string.h>
+
+using namespace osgHaptics;
+
+namespace {
+  const char s_trace_magic[8] = "OHTRACE";
+  const unsigned int s_trace_version = 2;
+}
+
+TraceRingBuffer::TraceRingBuffer(unsigned int capacity)
+{
+  unsigned int size = 2;
+  while (size < capacity && size < 0x40000000)
+    size <<= 1;
+
+  m_records.resize(size);
+  m_mask = size-1;
+}
+
+bool TraceRingBuffer::push(const TraceRecord& record)
+{
+  unsigned int head = m_head;
+  if (head - unsigned(m_tail) > m_mask) {
+    ++m_dropped;
+    return false;
+  }
+
+  m_records[head & m_mask] = record;
+
+  // Publish the record to the consumer
+  ++m_head;
+  return true;
+}
+
+bool TraceRingBuffer::pop(TraceRecord& record)
+{
+  unsigned int tail = m_tail;
+  if (tail == unsigned(m_head))
+    return false;
+
+  record = m_records[tail & m_mask];
+
+  // Hand the slot back to the producer
+  ++m_tail;
+  return true;
+}
+
+
+ServoTraceWriter::ServoTraceWriter(const std::string& filename, unsigned int buffer_size) : 
+  m_buffer(buffer_size), m_open(false)
+{
+  m_file.open(filename.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if (!m_file.is_open()) {
+    osg::notify(osg::WARN) << "ServoTraceWriter: Unable to open " << filename << " for writing" << std::endl;
+    return;
+  }
+
+  TraceFileHeader header;
+  memcpy(header.magic, s_trace_magic, sizeof(header.magic));
+  header.version = s_trace_version;
+  header.record_size = sizeof(TraceRecord);
+  m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  m_write_buffer.reserve(256);
+  m_open = true;
+  start();
+}
+
+ServoTraceWriter::~ServoTraceWriter()
+{
+  close();
+}
+
+void ServoTraceWriter::close()
+{
+  if (!m_open)
+    return;
+
+  stop();
+  if (isRunning() && !wait(2000)) {
+    osg::notify(osg::WARN) << "ServoTraceWriter::close(): Unable to stop the writer thread" << std::endl;
+    cancel();
+  }
+
+  // Anything pushed after the thread stopped
+  drain();
+  m_file.close();
+  m_open = false;
+
+  if (getNumDropped())
+    osg::notify(osg::WARN) << "ServoTraceWriter: " << getNumDropped() << " records did not fit in the buffer and were dropped" << std::endl;
+}
+
+void ServoTraceWriter::drain()
+{
+  TraceRecord record;
+  while (m_buffer.pop(record)) {
+    m_write_buffer.push_back(record);
+    if (m_write_buffer.size() == m_write_buffer.capacity()) {
+      m_file.write(reinterpret_cast<const char *>(&m_write_buffer[0]), m_write_buffer.size()*sizeof(TraceRecord));
+      m_write_buffer.clear();
+    }
+  }
+
+  if (!m_write_buffer.empty()) {
+    m_file.write(reinterpret_cast<const char *>(&m_write_buffer[0]), m_write_buffer.size()*sizeof(TraceRecord));
+    m_write_buffer.clear();
+  }
+}
+
+void ServoTraceWriter::run()
+{
+  while (!shouldStop()) {
+    drain();
+
+    // The servo loop produces one record per millisecond, so there is no need to hurry
+    OpenThreads::Thread::microSleep(10*1000);
+  }
+
+  drain();
+  exit();
+}
+
+
+bool ServoTraceReader::open(const std::string& filename)
+{
+  m_file.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!m_file.is_open()) {
+    osg::notify(osg::WARN) << "ServoTraceReader: Unable to open " << filename << std::endl;
+    return false;
+  }
+
+  TraceFileHeader header;
+  if (!m_file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+    memcmp(header.magic, s_trace_magic, sizeof(header.magic)) != 0) {
+    osg::notify(osg::WARN) << "ServoTraceReader: " << filename << " is not a trace file" << std::endl;
+    m_file.close();
+    return false;
+  }
+
+  if (header.version != s_trace_version || header.record_size != sizeof(TraceRecord)) {
+    osg::notify(osg::WARN) << "ServoTraceReader: " << filename << " has an unsupported version (" 
+      << header.version << ") or record size (" << header.record_size << ")" << std::endl;
+    m_file.close();
+    return false;
+  }
+
+  return true;
+}
+
+bool ServoTraceReader::read(TraceRecord& record)
+{
+  if (!m_file.is_open())
+    return false;
+
+  return !!m_file.read(reinterpret_cast<char *>(&record), sizeof(record));
+}
+
+void ServoTraceReader::writeCSVHeader(std::ostream& os)
+{
+  os << "tick,time,px,py,pz,vx,vy,vz,buttons,fx,fy,fz,tx,ty,tz,operators" << std::endl;
+}
+
+void ServoTraceReader::writeCSV(std::ostream& os, const TraceRecord& r)
+{
+  const ServoInput& in = r.input;
+  os << r.tick << "," << in.time << ","
+    << in.transform[12] << "," << in.transform[13] << "," << in.transform[14] << ","
+    << in.velocity[0] << "," << in.velocity[1] << "," << in.velocity[2] << ","
+    << in.buttons << ","
+    << r.force[0] << "," << r.force[1] << "," << r.force[2] << ","
+    << r.torque[0] << "," << r.torque[1] << "," << r.torque[2] << ","
+    << r.num_operators << "\n";
+}
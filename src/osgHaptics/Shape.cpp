@@ -25,14 +25,21 @@
 #include <osg/Notify>
 #include <osg/Matrix>
 #include <osgHaptics/types.h>
+#include <osg/GL>
 
 #include <iostream>
 
 
 using namespace osgHaptics;
 
+namespace {
+  /// Below this, capturing every triangle costs less than reading back the depth buffer
+  const unsigned int DEFAULT_DEPTH_BUFFER_THRESHOLD = 20000;
+}
+
 Shape::Shape(HapticDevice *device, const std::string& name) : m_name(name), m_enabled(1),
-  m_device(device)
+  m_shape_type(FEEDBACK_BUFFER), m_depth_buffer_threshold(DEFAULT_DEPTH_BUFFER_THRESHOLD), 
+  m_current_shape_type(FEEDBACK_BUFFER), m_device(device)
 {
 
 	//register this device for this shape
@@ -41,7 +48,8 @@ Shape::Shape(HapticDevice *device, const std::string& name) : m_name(name), m_en
 }
 
 Shape::Shape(HapticDevice *device, int enabled) : m_name("no name"), m_enabled(enabled),
-  m_device(device)
+  m_shape_type(FEEDBACK_BUFFER), m_depth_buffer_threshold(DEFAULT_DEPTH_BUFFER_THRESHOLD), 
+  m_current_shape_type(FEEDBACK_BUFFER), m_device(device)
 {
 
   //register this device for this shape
@@ -50,7 +58,9 @@ Shape::Shape(HapticDevice *device, int enabled) : m_name("no name"), m_enabled(e
 
 
 //--by SophiaSoo/CUHK: for two arms, NEW CONSTRUCTOR
-Shape::Shape() : m_name("no name"), m_shape_id(0) , m_enabled(1) {}
+Shape::Shape() : m_name("no name"), m_shape_id(0) , m_enabled(1), 
+  m_shape_type(FEEDBACK_BUFFER), m_depth_buffer_threshold(DEFAULT_DEPTH_BUFFER_THRESHOLD), 
+  m_current_shape_type(FEEDBACK_BUFFER) {}
 
 
 Shape::~Shape()
@@ -65,19 +75,40 @@ Shape::~Shape()
 			continue;
 
 		m_devices[i]->unRegisterContactEventHandler(this);
+		if (m_devices[i]->isSimulated())
+			continue;
+
 		m_devices[i]->makeCurrent();
 		hlDeleteShapes(m_shape_ids[i], 1);
   } //for
 
 }
 
-void Shape::preDraw() const
+void Shape::preDraw(unsigned int num_triangles) const
 {
   //--by SophiaSoo/CUHK: for two arms
   int idx = getCurrentDeviceIndex();
   if (isValidIndex(idx)) {
  		if (m_enabled && m_devices[idx].valid() && m_devices[idx]->getEnableShapeRender()) {
-			hlBeginShape(HL_SHAPE_FEEDBACK_BUFFER, m_shape_ids[idx]);
+
+      m_current_shape_type = m_shape_type;
+      if (m_shape_type == AUTOMATIC_SHAPE_TYPE)
+        m_current_shape_type = (num_triangles > m_depth_buffer_threshold) ? DEPTH_BUFFER : FEEDBACK_BUFFER;
+
+      if (m_current_shape_type == DEPTH_BUFFER) {
+        // HL captures the shape from the depth buffer, so it has to be written whatever the state of the drawable says
+        glPushAttrib(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        hlBeginShape(HL_SHAPE_DEPTH_BUFFER, m_shape_ids[idx]);
+      }
+      else {
+        // Lets HL allocate the feedback buffer once instead of growing it.
+        // The hint is part of the HL context, so it is reset to the HL default (65536) when the size is unknown
+        hlHinti(HL_SHAPE_FEEDBACK_BUFFER_VERTICES, num_triangles ? 3*num_triangles : 65536);
+        hlBeginShape(HL_SHAPE_FEEDBACK_BUFFER, m_shape_ids[idx]);
+      }
 		}
   } //if
 
@@ -91,6 +122,8 @@ void Shape::postDraw() const
   if (isValidIndex(idx)) {
  		if (m_enabled && m_devices[idx].valid() && m_devices[idx]->getEnableShapeRender()) {
 			hlEndShape(); 
+      if (m_current_shape_type == DEPTH_BUFFER)
+        glPopAttrib();
 		}
   } //if
 
@@ -113,6 +146,13 @@ void Shape::addDevice(HapticDevice *device)
 	if (found)
 		return;
 
+  // A simulated device has no HL context, the shape is never rendered to it
+  if (device->isSimulated()) {
+    m_devices.push_back(device);
+    m_shape_ids.push_back(0);
+    return;
+  }
+
 	// Create a shape id for this device context
   m_shape_id = hlGenShapes(1);
 
@@ -0,0 +1,247 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/SimulatedDevice.h>
+#include <osgHaptics/HapticDevice.h>
+#include <osg/Timer>
+#include <osg/Notify>
+#include <OpenThreads/ScopedLock>
+#include <math.h>
+
+using namespace osgHaptics;
+
+
+osg::Vec3d SimulatedDevice::CircleTrajectory::getPosition(double time) const
+{
+  double angle = 2*osg::PI*m_frequency*time;
+  return m_center + m_axis1*cos(angle) + m_axis2*sin(angle);
+}
+
+
+void SimulatedDevice::WaypointTrajectory::addWaypoint(double time, const osg::Vec3d& position, int buttons)
+{
+  if (!m_waypoints.empty() && time <= m_waypoints.back().time) {
+    osg::notify(osg::WARN) << "WaypointTrajectory::addWaypoint(): Waypoints must be added in increasing time order" << std::endl;
+    return;
+  }
+
+  Waypoint w;
+  w.time = time;
+  w.position = position;
+  w.buttons = buttons;
+  m_waypoints.push_back(w);
+}
+
+unsigned int SimulatedDevice::WaypointTrajectory::findWaypoint(double& time) const
+{
+  double start = m_waypoints.front().time;
+  double end = m_waypoints.back().time;
+  if (m_loop && end > start && time > end)
+    time = start + fmod(time-start, end-start);
+
+  unsigned int i=0;
+  while (i+1 < m_waypoints.size() && m_waypoints[i+1].time <= time)
+    i++;
+  return i;
+}
+
+osg::Vec3d SimulatedDevice::WaypointTrajectory::getPosition(double time) const
+{
+  if (m_waypoints.empty())
+    return osg::Vec3d(0,0,0);
+
+  unsigned int i = findWaypoint(time);
+  const Waypoint& a = m_waypoints[i];
+  if (i+1 == m_waypoints.size() || time <= a.time)
+    return a.position;
+
+  const Waypoint& b = m_waypoints[i+1];
+  double s = (time-a.time)/(b.time-a.time);
+  return a.position*(1.0-s) + b.position*s;
+}
+
+int SimulatedDevice::WaypointTrajectory::getButtons(double time) const
+{
+  if (m_waypoints.empty())
+    return 0;
+
+  return m_waypoints[findWaypoint(time)].buttons;
+}
+
+
+SimulatedDevice::SimulatedDevice(HapticDevice *device) : 
+  m_device(device), m_update_rate(1000), m_running(false), m_buttons(0)
+{
+  setTrajectory(new FixedTrajectory);
+}
+
+SimulatedDevice::~SimulatedDevice()
+{
+  stopScheduler();
+}
+
+void SimulatedDevice::setUpdateRate(unsigned int hz)
+{
+  if (hz < 1000)
+    hz = 1000;
+  if (hz > 4000)
+    hz = 4000;
+  m_update_rate = hz;
+}
+
+void SimulatedDevice::setParameters(const Parameters& parameters)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  m_parameters = parameters;
+  m_parameter_buffer.write(m_parameters);
+}
+
+SimulatedDevice::Parameters SimulatedDevice::getParameters() const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  Parameters p = m_parameters;
+  return p;
+}
+
+void SimulatedDevice::setTrajectory(Trajectory *trajectory)
+{
+  if (!trajectory)
+    return;
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  m_trajectories.push_back(trajectory);
+  m_trajectory.assign(trajectory, m_trajectory.get());
+}
+
+void SimulatedDevice::startScheduler()
+{
+  if (m_running)
+    return;
+
+  // Start where the hand is
+  const Trajectory *trajectory = static_cast<const Trajectory *>(m_trajectory.get());
+  m_position = trajectory->getPosition(0);
+
+  m_running = true;
+  start();
+  setSchedulePriority(OpenThreads::Thread::THREAD_PRIORITY_MAX);
+}
+
+void SimulatedDevice::stopScheduler()
+{
+  if (!m_running)
+    return;
+
+  stop();
+  if (!wait(2000)) {
+    osg::notify(osg::WARN) << "SimulatedDevice::stopScheduler(): Unable to stop the servo thread" << std::endl;
+    cancel();
+  }
+  m_running = false;
+}
+
+void SimulatedDevice::getState(ServoInput& state, osg::Vec3d& force, osg::Vec3d& torque)
+{
+  const State& s = m_state_buffer.read();
+  state = s.input;
+  force = s.force;
+  torque = s.torque;
+}
+
+void SimulatedDevice::integrate(const Parameters& p, double time, double dt, const osg::Vec3d& force)
+{
+  const Trajectory *trajectory = static_cast<const Trajectory *>(m_trajectory.get());
+  osg::Vec3d hand = trajectory->getPosition(time);
+  m_buttons = trajectory->getButtons(time);
+
+  // The hand holds the end effector with a spring-damper
+  osg::Vec3d total_force = (hand - m_position)*p.stiffness - m_velocity*p.damping + force;
+
+  // Semi-implicit Euler, acceleration in mm/s^2
+  m_last_velocity = m_velocity;
+  m_velocity += total_force*(1000.0/p.mass*dt);
+  m_position += m_velocity*dt;
+}
+
+void SimulatedDevice::run()
+{
+  osg::Timer *timer = osg::Timer::instance();
+  osg::Timer_t start = timer->tick();
+  double period = 1.0/m_update_rate;
+  double next_tick = 0;
+
+  osg::Vec3d force, torque;
+  State state;
+
+  while (!shouldStop()) {
+    const Parameters& p = m_parameter_buffer.read();
+    double time = timer->delta_s(start, timer->tick());
+
+    // Move the end effector with the force from the previous tick
+    integrate(p, time, period, force);
+
+    ServoInput& input = state.input;
+    input.time = HapticDevice::getTimeStamp();
+    for(unsigned int i=0; i < 16; i++)
+      input.transform[i] = (i % 5) ? 0.0 : 1.0;
+    for(unsigned int i=0; i < 3; i++) {
+      input.transform[12+i] = m_position[i];
+      input.velocity[i] = m_velocity[i];
+      input.last_velocity[i] = m_last_velocity[i];
+      input.angular_velocity[i] = 0;
+
+      // There is no HL rendering anything before the ForceOperators
+      input.force[i] = 0;
+      input.torque[i] = 0;
+    }
+    input.buttons = m_buttons;
+    input.pad = 0;
+
+    m_device->runServoTick(input, force, torque);
+
+    // As with hdDisable(HD_FORCE_OUTPUT), the force is computed but not applied
+    if (!m_device->getEnableForceOutput()) {
+      force.set(0,0,0);
+      torque.set(0,0,0);
+    }
+
+    state.force = force;
+    state.torque = torque;
+    m_state_buffer.write(state);
+
+    // Wait for the next tick. Sleep while there is plenty of time left, then yield for better precision.
+    next_tick += period;
+    double remaining = next_tick - timer->delta_s(start, timer->tick());
+    if (remaining < -0.1) {
+      // We are far behind (debugger, heavily loaded machine), dont try to catch up
+      next_tick = timer->delta_s(start, timer->tick());
+    }
+    while (remaining > 0) {
+      if (remaining > 0.0005)
+        OpenThreads::Thread::microSleep((unsigned int)((remaining-0.0003)*1e6));
+      else
+        OpenThreads::Thread::YieldCurrentThread();
+      remaining = next_tick - timer->delta_s(start, timer->tick());
+    }
+  }
+
+  exit();
+}
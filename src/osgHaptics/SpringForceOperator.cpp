@@ -19,6 +19,7 @@
 */
 
 #include <stdlib.h>
+#include <math.h>
 #include <osgHaptics/SpringForceOperator.h>
 
 #include <HD/hd.h>
@@ -30,86 +31,91 @@ using namespace osgHaptics;
 
 SpringForceOperator::SpringForceOperator() : 
     ForceOperator(), 
-    m_stiffness(1), 
-    m_damping(0.001),
+    m_position_serial(0),
     m_fade(false), 
-    m_fade_started(false), 
-    m_fadein_ms(0),
-    m_fade_start_time(0)
+    m_fade_start_time(0),
+    m_current_fade(1),
+    m_fade_force_serial(0),
+    m_fade_force(false),
+    m_fade_force_start_time(0)
 {
   m_max_stiffness = 200;
   //hdGetDoublev(HD_NOMINAL_MAX_STIFFNESS, &m_max_stiffness);
 }
 
-void SpringForceOperator::calculateForce(const osg::Vec3d& in, osg::Vec3d& out, double time)
+void SpringForceOperator::calculateForce(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out)
 {
+  double time = frame.time;
 
-  osg::Vec3d current_pos;
-  hdGetDoublev(HD_CURRENT_POSITION, current_pos.ptr());
+  // Get the latest parameters published by the application, never blocks
+  const Parameters& p = m_parameter_buffer.read();
 
   // Calculate the damping force -b*v
-  osg::Vec3d curr_vel;
-  hdGetDoublev(HD_LAST_VELOCITY, curr_vel.ptr());  
-  osg::Vec3 damp_force = -curr_vel*m_damping;
+  osg::Vec3 damp_force = -frame.last_velocity*p.damping;
 
-  // Lock the ForceOperator
-  m_mutex.lock();
+  osg::Vec3 world_pos = frame.workspace_to_world.preMult(frame.position);
 
-  osg::Vec3 world_pos = m_workspace_to_world_matrix.preMult(current_pos);
-  osg::Vec3 m_current_position=m_target_position;
-  if (m_fade) {
-    
-    // We are fading, store the current time as the start of the fading.
-    if (!m_fade_started) {
-      m_fade_started = true;
+  // A new anchor position has been set
+  if (p.position_serial != m_position_serial) {
+    m_position_serial = p.position_serial;
+
+    m_fade = p.fadein_ms > 0;
+    if (m_fade) {
+      // We are fading, store the current time as the start of the fading.
       m_fade_start_time = time; // Start time for interpolation
       m_position = world_pos; // Save current position
     }
-    double s = (time-m_fade_start_time)/(m_fadein_ms*0.001);
-    m_current_position = vrutils::mix(m_position, m_target_position, s);
+  }
+
+  m_current_position = p.target_position;
+  if (m_fade) {
+    
+    double s = (time-m_fade_start_time)/(p.fadein_ms*0.001);
+    m_current_position = vrutils::mix(m_position, p.target_position, s);
 
     // Are we there yet?
-    if (time > m_fade_start_time+m_fadein_ms)
+    if (time > m_fade_start_time+p.fadein_ms*0.001)
       m_fade = false;
   }
 
+  // setEnable() has been called, start a new fade of the stiffness (or stop the current one)
+  if (p.fade_force_serial != m_fade_force_serial) {
+    m_fade_force_serial = p.fade_force_serial;
+    m_fade_force = p.fade_force;
+    m_fade_force_start_time = time;
+  }
+
   // Set this if we are fading the Spring out to true, and we will disable the spring
   bool should_disable = false;
   m_current_fade = 1;
   // We are fading stiffness
   if (m_fade_force) {
     
-    // We are fading, store the current time as the start of the fading.
-    if ( !m_fade_force_started ) {
-      m_fade_force_started = true;
-      m_fade_force_start_time = time;
-    }
-    
-    double s = (time-m_fade_force_start_time)/(m_fade_force_time*0.001);
+    double s = (time-m_fade_force_start_time)/(p.fade_force_time*0.001);
     
     // Are we fading up or down
-    if (m_fade_force_up)
+    if (p.fade_force_up)
       m_current_fade = vrutils::mix(0.0, 1.0, s);
     else
       m_current_fade = vrutils::mix(1.0, 0.0, s);
 
     // Are we there yet ;-)
-    if (time >= (m_fade_force_start_time+m_fade_force_time*0.001)) {
+    if (time >= (m_fade_force_start_time+p.fade_force_time*0.001)) {
       m_fade_force = false;
     }
 
     // Are we fading out and done with it, disable the Spring
-    if (!m_fade_force && !m_fade_force_up) {
+    if (!m_fade_force && !p.fade_force_up) {
       should_disable = true;
     }
   }
 
   // Calculate the springforce as k*x
-  out = (m_current_position - world_pos)*m_stiffness;
+  out = (m_current_position - world_pos)*p.stiffness;
 
   // Transform the force back to workspace coordinates
   osg::Quat q;
-  q.set(m_world_to_workspace_matrix);
+  q.set(frame.world_to_workspace);
   osg::Matrix m;
   m.set(q);
   
@@ -117,11 +123,9 @@ void SpringForceOperator::calculateForce(const osg::Vec3d& in, osg::Vec3d& out,
   out = m.preMult(out) + damp_force;
   out *= m_current_fade;
 
-  // Unlock the ForceOperator
-  m_mutex.unlock();
-
+  // Only flip the enable flag, SpringForceOperator::setEnable() is for the application side
   if (should_disable) {
-    setEnable(false);
+    ForceOperator::setEnable(false);
   }
 
 }
@@ -130,48 +134,38 @@ void SpringForceOperator::setPosition(const osg::Vec3d& position, double fadein_
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
   const double epsilon=1E-10;
-  // If fadein_ms == 0, then dont interpolate position
-  if (abs(fadein_ms) < epsilon) {
-    m_position = position;
-	m_current_position = position;
-    m_target_position = position;
-    m_fade = false;
-    m_fadein_ms = 0;
-    m_fade_started = false; 
-  }
 
-  // Ok do interpolation of position
-  else {
-    // The position we are aiming for
-    // We will interpolate from m_position to m_target_position in fadein_ms milliseconds
-    m_target_position = position;
-    m_fade = true;
-    m_fade_started = false; // We havent started the interpolation yet
-    m_fadein_ms = fadein_ms;
-
-    // We should store the current time...
-    // What happens if this FOrceOperator is disabled?
-  }
+  // The position we are aiming for.
+  // If fadein_ms == 0, then dont interpolate position, otherwise the servo thread will interpolate
+  // from the current position to the new one in fadein_ms milliseconds
+  m_parameters.target_position = position;
+  m_parameters.fadein_ms = (fabs(fadein_ms) < epsilon) ? 0 : fadein_ms;
+  m_parameters.position_serial++;
+
+  m_parameter_buffer.write(m_parameters);
 }
 
 void SpringForceOperator::setStiffness(double stiffness)
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m_stiffness = vrutils::min(stiffness, m_max_stiffness);
+  m_parameters.stiffness = vrutils::min(stiffness, m_max_stiffness);
+  m_parameter_buffer.write(m_parameters);
 }
 
 void SpringForceOperator::setDamping(double damping)
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m_damping = damping;
+  m_parameters.damping = damping;
+  m_parameter_buffer.write(m_parameters);
 }
 
 void SpringForceOperator::setEnable(bool flag)
 {
   m_mutex.lock();
-  m_fade_force = false;
-  m_fade_force_start_time = 0;
-  m_fade_force_started = false;
+  // Stop any ongoing fade
+  m_parameters.fade_force = false;
+  m_parameters.fade_force_serial++;
+  m_parameter_buffer.write(m_parameters);
   m_mutex.unlock();
 
   ForceOperator::setEnable(flag);
@@ -186,16 +180,16 @@ void SpringForceOperator::setEnable(bool flag, double fade_ms)
     Then this call will be silently ignored.
 
   */
-  if (m_fade_force_started && m_fade_force && !flag && !m_fade_force_up && fade_ms > 1) {
+  if (m_parameters.fade_force && !flag && !m_parameters.fade_force_up && fade_ms > 1) {
     m_mutex.unlock();
     return;
   }
 
-  m_fade_force = true; // We will interpolate
-  m_fade_force_up = flag; // We will fade up/down
-  m_fade_force_time = fade_ms;  // The time it will take
-  m_fade_force_start_time = 0; // Current time not set
-  m_fade_force_started = false; // We havent started yet
+  m_parameters.fade_force = true; // We will interpolate
+  m_parameters.fade_force_up = flag; // We will fade up/down
+  m_parameters.fade_force_time = fade_ms;  // The time it will take
+  m_parameters.fade_force_serial++; // The servo thread will start the fade at its next tick
+  m_parameter_buffer.write(m_parameters);
   m_mutex.unlock();
 
   // If we are fading out the spring, then setEnable(false) will be called
@@ -0,0 +1,195 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/SpringGroupForceOperator.h>
+#include <vrutils/math.h>
+#include <osg/Notify>
+
+using namespace osgHaptics;
+
+SpringGroupForceOperator::SpringGroupForceOperator() : ForceOperator(), m_max_stiffness(200)
+{
+}
+
+void SpringGroupForceOperator::calculateForce(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out)
+{
+  // Get the latest springs published by the application, never blocks
+  const Parameters& p = m_parameter_buffer.read();
+
+  unsigned int n = p.stiffness.size();
+  if (!n) {
+    out.set(0,0,0);
+    return;
+  }
+
+  osg::Vec3d world_pos = frame.workspace_to_world.preMult(frame.position);
+  const double px = world_pos.x(), py = world_pos.y(), pz = world_pos.z();
+
+  // Sum of k*x over all springs. Plain arrays and scalar accumulators keep the loop vectorizable.
+  const double *x = &p.x[0], *y = &p.y[0], *z = &p.z[0], *k = &p.stiffness[0];
+  double fx=0, fy=0, fz=0;
+  for(unsigned int i=0; i < n; i++) {
+    fx += k[i]*(x[i]-px);
+    fy += k[i]*(y[i]-py);
+    fz += k[i]*(z[i]-pz);
+  }
+
+  // Transform the force back to workspace coordinates
+  osg::Quat q;
+  q.set(frame.world_to_workspace);
+  osg::Matrix m;
+  m.set(q);
+
+  // The damping of all springs act on the same velocity
+  out = m.preMult(osg::Vec3d(fx, fy, fz)) - frame.last_velocity*p.total_damping;
+}
+
+void SpringGroupForceOperator::publish()
+{
+  m_parameters.x.clear();
+  m_parameters.y.clear();
+  m_parameters.z.clear();
+  m_parameters.stiffness.clear();
+  m_parameters.total_damping = 0;
+
+  std::vector<Spring>::const_iterator it = m_springs.begin();
+  for(; it != m_springs.end(); it++) {
+    if (!it->enabled)
+      continue;
+
+    m_parameters.x.push_back(it->position.x());
+    m_parameters.y.push_back(it->position.y());
+    m_parameters.z.push_back(it->position.z());
+    m_parameters.stiffness.push_back(it->stiffness);
+    m_parameters.total_damping += it->damping;
+  }
+
+  m_parameter_buffer.write(m_parameters);
+}
+
+unsigned int SpringGroupForceOperator::addSpring(const osg::Vec3d& position, double stiffness, double damping)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  Spring s;
+  s.position = position;
+  s.stiffness = vrutils::min(stiffness, m_max_stiffness);
+  s.damping = damping;
+  s.enabled = true;
+  m_springs.push_back(s);
+  publish();
+
+  return m_springs.size()-1;
+}
+
+void SpringGroupForceOperator::removeAllSprings()
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  m_springs.clear();
+  publish();
+}
+
+unsigned int SpringGroupForceOperator::getNumSprings() const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  unsigned int n = m_springs.size();
+  return n;
+}
+
+void SpringGroupForceOperator::setPosition(unsigned int i, const osg::Vec3d& position)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_springs.size())
+    return;
+
+  m_springs[i].position = position;
+  publish();
+}
+
+osg::Vec3d SpringGroupForceOperator::getPosition(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  osg::Vec3d pos;
+  if (i < m_springs.size())
+    pos = m_springs[i].position;
+  return pos;
+}
+
+void SpringGroupForceOperator::setPositions(const std::vector<osg::Vec3d>& positions)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (positions.size() > m_springs.size())
+    osg::notify(osg::WARN) << "SpringGroupForceOperator::setPositions(): More positions than springs" << std::endl;
+
+  for(unsigned int i=0; i < positions.size() && i < m_springs.size(); i++)
+    m_springs[i].position = positions[i];
+  publish();
+}
+
+void SpringGroupForceOperator::setStiffness(unsigned int i, double stiffness)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_springs.size())
+    return;
+
+  m_springs[i].stiffness = vrutils::min(stiffness, m_max_stiffness);
+  publish();
+}
+
+double SpringGroupForceOperator::getStiffness(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  double s = i < m_springs.size() ? m_springs[i].stiffness : 0;
+  return s;
+}
+
+void SpringGroupForceOperator::setDamping(unsigned int i, double damping)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_springs.size())
+    return;
+
+  m_springs[i].damping = damping;
+  publish();
+}
+
+double SpringGroupForceOperator::getDamping(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  double d = i < m_springs.size() ? m_springs[i].damping : 0;
+  return d;
+}
+
+void SpringGroupForceOperator::setSpringEnable(unsigned int i, bool flag)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_springs.size())
+    return;
+
+  m_springs[i].enabled = flag;
+  publish();
+}
+
+bool SpringGroupForceOperator::getSpringEnable(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  bool f = i < m_springs.size() && m_springs[i].enabled;
+  return f;
+}
@@ -0,0 +1,441 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+
+#include <osgHaptics/TriangleCache.h>
+#include <osgHaptics/TriangleExtractor.h>
+#include <osg/Notify>
+#include <fstream>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace osgHaptics;
+
+namespace {
+  const char s_cache_magic[8] = "OHCACHE";
+  const unsigned int s_cache_version = 1;
+
+  /// Arrays in the file start at multiples of this
+  const unsigned int s_cache_alignment = 16;
+
+  /// Header written first in a cache file, followed by the arrays at the given offsets
+  struct TriangleCacheHeader {
+    char magic[8];                  // "OHCACHE"
+    unsigned int version;
+    unsigned int node_size;         // sizeof(TriangleCache::Hierarchy::Node) of the writer
+    unsigned int vertex_size;       // sizeof(osg::Vec3) of the writer
+    unsigned int byte_order;        // 0x01020304 as written by the writer
+    TriangleCache::Key key;
+    unsigned int num_triangles;
+    unsigned int num_nodes;
+    unsigned int vertex_offset;     // num_triangles*3 osg::Vec3
+    unsigned int node_offset;       // num_nodes Hierarchy::Node
+    unsigned int item_offset;       // num_triangles unsigned int
+    unsigned int item_bound_offset; // num_triangles osg::BoundingBox
+    unsigned int leaf_index_offset; // num_triangles unsigned int
+    unsigned int file_size;
+  };
+
+  unsigned int align(unsigned int offset)
+  {
+    return (offset + s_cache_alignment-1) / s_cache_alignment * s_cache_alignment;
+  }
+
+  /// Returns true if count elements of size at offset are aligned and lie after the header, within file_size
+  bool isValidSection(unsigned int offset, unsigned int count, unsigned int size, unsigned int file_size)
+  {
+    return offset % s_cache_alignment == 0 && offset >= sizeof(TriangleCacheHeader) &&
+      (unsigned long long)offset + (unsigned long long)count*size <= file_size;
+  }
+
+  /*!
+    Returns true if the nodes form one depth first tree no deeper than the queries can traverse,
+    with the items of the leaves within num_items.
+  */
+  bool isValidTree(const TriangleCache::Hierarchy::Node *nodes, unsigned int num_nodes, unsigned int num_items)
+  {
+    if (!num_nodes)
+      return true;
+
+    // The same traversal as BoundingVolumeHierarchy::query(), each node must be reached exactly once
+    unsigned int stack[TriangleCache::Hierarchy::MAX_DEPTH+2][2];
+    unsigned int top = 0, num_visited = 0;
+    stack[top][0] = 0;
+    stack[top++][1] = 0;
+
+    while (top) {
+      --top;
+      unsigned int index = stack[top][0], depth = stack[top][1];
+      const TriangleCache::Hierarchy::Node& node = nodes[index];
+      num_visited++;
+
+      if (node.count) {
+        if ((unsigned long long)node.offset + node.count > num_items)
+          return false;
+      }
+      else {
+        // Children come after their parent, so the traversal can not loop
+        if (depth >= TriangleCache::Hierarchy::MAX_DEPTH || index+1 >= num_nodes || 
+          node.offset <= index+1 || node.offset >= num_nodes)
+          return false;
+        stack[top][0] = node.offset;
+        stack[top++][1] = depth+1;
+        stack[top][0] = index+1;
+        stack[top++][1] = depth+1;
+      }
+
+      if (num_visited > num_nodes)
+        return false;
+    }
+
+    return num_visited == num_nodes;
+  }
+
+  /// Returns true if all values are less than max
+  bool isValidIndices(const unsigned int *values, unsigned int count, unsigned int max)
+  {
+    for(unsigned int i=0; i < count; i++)
+      if (values[i] >= max)
+        return false;
+    return true;
+  }
+
+  /// FNV-1a, 64 bits
+  class Hash {
+  public:
+    Hash() : m_value(14695981039346656037ULL) {}
+
+    void add(const void *data, unsigned int size)
+    {
+      const unsigned char *bytes = static_cast<const unsigned char *>(data);
+      for(unsigned int i=0; i < size; i++) {
+        m_value ^= bytes[i];
+        m_value *= 1099511628211ULL;
+      }
+    }
+
+    template<class V>
+    void add(const V& value) { add(&value, sizeof(value)); }
+
+    TriangleCache::Key get() const { return m_value; }
+
+  private:
+    TriangleCache::Key m_value;
+  };
+
+  /// Hashes each geometry with its accumulated matrix, in traversal order
+  class HashGeometries : public TriangleExtractor {
+  public:
+    HashGeometries() {}
+
+    TriangleCache::Key getKey() const { return m_hash.get(); }
+
+  protected:
+    virtual void apply(osg::Geometry& geom)
+    {
+      m_hash.add(getMatrix().ptr(), 16*sizeof(*getMatrix().ptr()));
+
+      const osg::Array *vertices = geom.getVertexArray();
+      if (vertices && vertices->getDataPointer())
+        m_hash.add(vertices->getDataPointer(), vertices->getTotalDataSize());
+
+      for(unsigned int i=0; i < geom.getNumPrimitiveSets(); i++) {
+        const osg::PrimitiveSet *primitives = geom.getPrimitiveSet(i);
+        m_hash.add(primitives->getMode());
+        m_hash.add(primitives->getNumIndices());
+        if (primitives->getDataPointer())
+          m_hash.add(primitives->getDataPointer(), primitives->getTotalDataSize());
+        else if (primitives->getNumIndices())
+          m_hash.add(primitives->index(0));
+      }
+    }
+
+    using TriangleExtractor::apply;
+
+  private:
+    Hash m_hash;
+  };
+}
+
+
+/// A read only memory mapping of a whole file
+struct TriangleCache::MappedFile {
+#ifdef _WIN32
+  MappedFile() : data(0L), size(0), file(INVALID_HANDLE_VALUE), mapping(0L) {}
+
+  bool open(const std::string& filename)
+  {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0L, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0L);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+    size = GetFileSize(file, 0L);
+    mapping = CreateFileMappingA(file, 0L, PAGE_READONLY, 0, 0, 0L);
+    if (mapping)
+      data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    return data != 0L;
+  }
+
+  ~MappedFile()
+  {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+  }
+
+  const char *data;
+  unsigned int size;
+  HANDLE file, mapping;
+#else
+  MappedFile() : data(0L), size(0), fd(-1) {}
+
+  bool open(const std::string& filename)
+  {
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+      return false;
+
+    size = st.st_size;
+    void *address = mmap(0L, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+      return false;
+    data = static_cast<const char *>(address);
+    return true;
+  }
+
+  ~MappedFile()
+  {
+    if (data) munmap(const_cast<char *>(data), size);
+    if (fd >= 0) ::close(fd);
+  }
+
+  const char *data;
+  unsigned int size;
+  int fd;
+#endif
+};
+
+
+TriangleCache::TriangleCache() : m_key(0), m_vertex_data(0L), m_num_triangles(0), m_file(0L)
+{
+}
+
+
+TriangleCache::~TriangleCache()
+{
+  close();
+}
+
+
+TriangleCache::Key TriangleCache::computeKey(osg::Node& node)
+{
+  HashGeometries hash;
+  hash.extract(node);
+  return hash.getKey();
+}
+
+
+bool TriangleCache::load(const std::string& filename, osg::Node& node, unsigned int num_threads)
+{
+  Key key = computeKey(node);
+  if (open(filename, key))
+    return true;
+
+  build(node, key, num_threads);
+  if (!write(filename))
+    osg::notify(osg::WARN) << "TriangleCache: Unable to write " << filename << std::endl;
+  return false;
+}
+
+
+void TriangleCache::build(osg::Node& node, Key key, unsigned int num_threads)
+{
+  close();
+  m_key = key;
+
+  ParallelTriangleExtractor extractor(num_threads);
+  extractor.extract(node, m_vertices);
+
+  m_num_triangles = m_vertices.size()/3;
+  m_vertex_data = m_vertices.empty() ? 0L : &m_vertices.front();
+
+  std::vector<osg::BoundingBox> bounds(m_num_triangles);
+  std::vector<unsigned int> indices(m_num_triangles);
+  for(unsigned int i=0; i < m_num_triangles; i++) {
+    bounds[i].expandBy(m_vertices[3*i]);
+    bounds[i].expandBy(m_vertices[3*i+1]);
+    bounds[i].expandBy(m_vertices[3*i+2]);
+    indices[i] = i;
+  }
+
+  m_hierarchy = new Hierarchy;
+  m_hierarchy->build(bounds, indices);
+}
+
+
+bool TriangleCache::write(const std::string& filename) const
+{
+  if (!m_hierarchy.valid())
+    return false;
+
+  TriangleCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, s_cache_magic, sizeof(header.magic));
+  header.version = s_cache_version;
+  header.node_size = sizeof(Hierarchy::Node);
+  header.vertex_size = sizeof(osg::Vec3);
+  header.byte_order = 0x01020304;
+  header.key = m_key;
+  header.num_triangles = m_num_triangles;
+  header.num_nodes = m_hierarchy->getNumNodes();
+
+  header.vertex_offset = align(sizeof(header));
+  header.node_offset = align(header.vertex_offset + 3*m_num_triangles*sizeof(osg::Vec3));
+  header.item_offset = align(header.node_offset + header.num_nodes*sizeof(Hierarchy::Node));
+  header.item_bound_offset = align(header.item_offset + m_num_triangles*sizeof(unsigned int));
+  header.leaf_index_offset = align(header.item_bound_offset + m_num_triangles*sizeof(osg::BoundingBox));
+  header.file_size = header.leaf_index_offset + m_num_triangles*sizeof(unsigned int);
+
+  // Other processes might have the old file mapped, so it is replaced instead of rewritten in place.
+  // Their mappings keep the old file, and a crash while writing leaves only the temporary file behind
+  std::string temporary = filename + ".tmp";
+  std::ofstream file(temporary.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if (!file.is_open())
+    return false;
+
+  // Each array is written at its offset, padded with zeros
+  struct Section {
+    unsigned int offset;
+    size_t size;
+    const void *data;
+  } sections[] = {
+    { 0, sizeof(header), &header },
+    { header.vertex_offset, 3*m_num_triangles*sizeof(osg::Vec3), m_vertex_data },
+    { header.node_offset, header.num_nodes*sizeof(Hierarchy::Node), m_hierarchy->getNodeData() },
+    { header.item_offset, m_num_triangles*sizeof(unsigned int), m_hierarchy->getItemData() },
+    { header.item_bound_offset, m_num_triangles*sizeof(osg::BoundingBox), m_hierarchy->getItemBoundData() },
+    { header.leaf_index_offset, m_num_triangles*sizeof(unsigned int), m_hierarchy->getLeafIndexData() }
+  };
+
+  const char padding[s_cache_alignment] = { 0 };
+  unsigned int position = 0;
+  for(unsigned int i=0; i < sizeof(sections)/sizeof(sections[0]); i++) {
+    file.write(padding, sections[i].offset-position);
+    if (sections[i].size)
+      file.write(static_cast<const char *>(sections[i].data), sections[i].size);
+    position = sections[i].offset + sections[i].size;
+  }
+
+  file.close();
+  if (file.fail()) {
+    ::remove(temporary.c_str());
+    return false;
+  }
+
+#ifdef _WIN32
+  bool replaced = MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  bool replaced = ::rename(temporary.c_str(), filename.c_str()) == 0;
+#endif
+  if (!replaced)
+    ::remove(temporary.c_str());
+  return replaced;
+}
+
+
+bool TriangleCache::open(const std::string& filename, Key key)
+{
+  close();
+
+  MappedFile *file = new MappedFile;
+  if (!file->open(filename) || file->size < sizeof(TriangleCacheHeader)) {
+    delete file;
+    return false;
+  }
+
+  const TriangleCacheHeader& header = *reinterpret_cast<const TriangleCacheHeader *>(file->data);
+  if (memcmp(header.magic, s_cache_magic, sizeof(header.magic)) != 0 || header.version != s_cache_version ||
+    header.node_size != sizeof(Hierarchy::Node) || header.vertex_size != sizeof(osg::Vec3) || 
+    header.byte_order != 0x01020304 || header.file_size != file->size) {
+    osg::notify(osg::WARN) << "TriangleCache: " << filename << " is not a valid cache for this platform" << std::endl;
+    delete file;
+    return false;
+  }
+
+  if (header.key != key) {
+    osg::notify(osg::INFO) << "TriangleCache: " << filename << " was written for another model" << std::endl;
+    delete file;
+    return false;
+  }
+
+  // The arrays are used in place, so a damaged file must not make the queries read outside of them
+  const Hierarchy::Node *nodes = reinterpret_cast<const Hierarchy::Node *>(file->data + header.node_offset);
+  const unsigned int *items = reinterpret_cast<const unsigned int *>(file->data + header.item_offset);
+  const unsigned int *leaf_index = reinterpret_cast<const unsigned int *>(file->data + header.leaf_index_offset);
+  if (!isValidSection(header.vertex_offset, header.num_triangles, 3*sizeof(osg::Vec3), file->size) ||
+    !isValidSection(header.node_offset, header.num_nodes, sizeof(Hierarchy::Node), file->size) ||
+    !isValidSection(header.item_offset, header.num_triangles, sizeof(unsigned int), file->size) ||
+    !isValidSection(header.item_bound_offset, header.num_triangles, sizeof(osg::BoundingBox), file->size) ||
+    !isValidSection(header.leaf_index_offset, header.num_triangles, sizeof(unsigned int), file->size) ||
+    !isValidTree(nodes, header.num_nodes, header.num_triangles) || 
+    !isValidIndices(items, header.num_triangles, header.num_triangles) ||
+    !isValidIndices(leaf_index, header.num_triangles, header.num_triangles)) {
+    osg::notify(osg::WARN) << "TriangleCache: " << filename << " is damaged" << std::endl;
+    delete file;
+    return false;
+  }
+
+  m_file = file;
+  m_key = key;
+  m_num_triangles = header.num_triangles;
+  m_vertex_data = reinterpret_cast<const osg::Vec3 *>(file->data + header.vertex_offset);
+
+  m_hierarchy = new Hierarchy;
+  m_hierarchy->setExternalData(nodes, header.num_nodes, items, 
+    reinterpret_cast<const osg::BoundingBox *>(file->data + header.item_bound_offset), leaf_index, m_num_triangles);
+  return true;
+}
+
+
+void TriangleCache::close()
+{
+  // The hierarchy may refer to the mapping
+  m_hierarchy = 0L;
+  m_vertices.clear();
+  m_vertex_data = 0L;
+  m_num_triangles = 0;
+
+  delete m_file;
+  m_file = 0L;
+}
@@ -1,9 +1,143 @@
 // $Id: TriangleExtractor.cpp,v 1.1 2005/04/11 11:05:52 andersb Exp $
 
 #include "osgHaptics/TriangleExtractor.h"
+#include <osg/Billboard>
+#include <osg/TriangleIndexFunctor>
+#include <osg/Math>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
 using namespace osgHaptics;
 
-TriangleExtractor::TriangleExtractor(TriangleExtractOperator& op) : m_tri_op(op),
+namespace {
+
+  /// Collects the indices of the non degenerate triangles of a geometry
+  struct CollectIndices {
+    CollectIndices() : m_vertices(0L), m_indices(0L) {}
+
+    void operator () (unsigned int i1, unsigned int i2, unsigned int i3)
+    {
+      const osg::Vec3& v1 = m_vertices[i1];
+      const osg::Vec3& v2 = m_vertices[i2];
+      const osg::Vec3& v3 = m_vertices[i3];
+      if (v1==v2 || v2==v3 || v1==v3) 
+        return;
+
+      m_indices->push_back(i1);
+      m_indices->push_back(i2);
+      m_indices->push_back(i3);
+    }
+
+    const osg::Vec3 *m_vertices;
+    std::vector<unsigned int> *m_indices;
+  };
+
+  /// Copies the vertices of the non degenerate triangles of a geometry that has no plain vertex array
+  struct CopyTriangles {
+    CopyTriangles() : m_vertices(0L), m_indices(0L) {}
+
+    void operator () (const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3, bool)
+    {
+      if (v1==v2 || v2==v3 || v1==v3) 
+        return;
+
+      for(unsigned int i=0; i < 3; i++)
+        m_indices->push_back(m_vertices->size()+i);
+      m_vertices->push_back(v1);
+      m_vertices->push_back(v2);
+      m_vertices->push_back(v3);
+    }
+
+    std::vector<osg::Vec3> *m_vertices;
+    std::vector<unsigned int> *m_indices;
+  };
+
+  /// Extracts the work items it takes from a shared counter into a buffer of its own
+  class ExtractWorker : public OpenThreads::Thread {
+  public:
+    ExtractWorker(const std::vector<ParallelTriangleExtractor::WorkItem>& items, unsigned int& next, 
+      OpenThreads::Mutex& mutex) : m_items(&items), m_next(&next), m_mutex(&mutex) {}
+
+    virtual void run()
+    {
+      std::vector<osg::Vec3> world;
+      for(;;) {
+        unsigned int i;
+        {
+          OpenThreads::ScopedLock<OpenThreads::Mutex> lock(*m_mutex);
+          i = (*m_next)++;
+        }
+        if (i >= m_items->size())
+          break;
+
+        const ParallelTriangleExtractor::WorkItem& item = (*m_items)[i];
+        TriangleExtractor::extractBatch(*item.geometry, item.matrix, m_batch);
+        m_batch.transformVertices(world);
+
+        Chunk chunk;
+        chunk.item = i;
+        chunk.offset = m_vertices.size();
+        chunk.count = m_batch.getIndices().size();
+        m_chunks.push_back(chunk);
+
+        const std::vector<unsigned int>& indices = m_batch.getIndices();
+        for(unsigned int j=0; j < indices.size(); j++)
+          m_vertices.push_back(world[indices[j]]);
+      }
+    }
+
+    /// The vertices of work item 'item' are at [offset, offset+count) in m_vertices
+    struct Chunk {
+      unsigned int item, offset, count;
+    };
+
+    std::vector<osg::Vec3> m_vertices;
+    std::vector<Chunk> m_chunks;
+
+  private:
+    const std::vector<ParallelTriangleExtractor::WorkItem> *m_items;
+    unsigned int *m_next;
+    OpenThreads::Mutex *m_mutex;
+    TriangleBatch m_batch;
+  };
+}
+
+
+void TriangleBatch::transformVertices(std::vector<osg::Vec3>& world) const
+{
+  world.resize(m_num_vertices);
+
+  // Transforms in the scenegraph are affine, so no projective divide as in Matrix::preMult.
+  // Keeping the matrix in floats lets the compiler vectorize the loop.
+  const osg::Matrix& m = m_matrix;
+  const float m00 = m(0,0), m01 = m(0,1), m02 = m(0,2);
+  const float m10 = m(1,0), m11 = m(1,1), m12 = m(1,2);
+  const float m20 = m(2,0), m21 = m(2,1), m22 = m(2,2);
+  const float m30 = m(3,0), m31 = m(3,1), m32 = m(3,2);
+
+  for(unsigned int i=0; i < m_num_vertices; i++) {
+    const float x = m_vertices[i].x(), y = m_vertices[i].y(), z = m_vertices[i].z();
+    world[i].set(x*m00 + y*m10 + z*m20 + m30,
+                 x*m01 + y*m11 + z*m21 + m31,
+                 x*m02 + y*m12 + z*m22 + m32);
+  }
+}
+
+
+TriangleExtractor::TriangleExtractor(TriangleExtractOperator& op) : m_tri_op(&op), m_batch_op(0L),
+  m_num_triangles(0)
+{
+  setTraversalMode(NodeVisitor::TRAVERSE_ACTIVE_CHILDREN);
+}
+
+TriangleExtractor::TriangleExtractor(TriangleBatchOperator& op) : m_tri_op(0L), m_batch_op(&op),
+  m_num_triangles(0)
+{
+  setTraversalMode(NodeVisitor::TRAVERSE_ACTIVE_CHILDREN);
+}
+
+TriangleExtractor::TriangleExtractor() : m_tri_op(0L), m_batch_op(0L),
   m_num_triangles(0)
 {
   setTraversalMode(NodeVisitor::TRAVERSE_ACTIVE_CHILDREN);
@@ -27,22 +161,18 @@ void TriangleExtractor::extract(osg::Node& node)
 
 void TriangleExtractor::pushMatrix(const osg::Matrix& matrix)
 {
-    
-  osg::ref_ptr<osg::RefMatrix> new_matrix;
+  m_matrix_stack.push_back(matrix);
 
   // Is there any matrices in the stack before?
-  if (m_matrix_stack.size()) {
-
-    // YEs, then accumulate the new matrix with the previous one.
-    new_matrix = new osg::RefMatrix;
-    new_matrix->mult(matrix, *(m_matrix_stack.back()));//*old_matrix);
-  } else {
-
-    // Otherwise, just store this matrix
-    new_matrix = new osg::RefMatrix(matrix);
-  }
+  // YEs, then accumulate the new matrix with the previous one.
+  if (m_matrix_stack.size() > 1)
+    m_matrix_stack.back().postMult(m_matrix_stack[m_matrix_stack.size()-2]);
+}
 
-  m_matrix_stack.push_back(new_matrix);
+const osg::Matrix& TriangleExtractor::getMatrix() const
+{
+  static const osg::Matrix identity;
+  return m_matrix_stack.empty() ? identity : m_matrix_stack.back();
 }
 
 // Leaving the subgraph, pop the matrix from the stack
@@ -70,10 +200,10 @@ void TriangleExtractor::apply(osg::Group& node)
 
 void TriangleExtractor::apply(osg::Transform& node)
 {
-  osg::ref_ptr<osg::RefMatrix> matrix = new osg::RefMatrix;
-  node.computeLocalToWorldMatrix(*matrix,this);
+  osg::Matrix matrix;
+  node.computeLocalToWorldMatrix(matrix,this);
 
-  pushMatrix(*matrix);
+  pushMatrix(matrix);
 
   traverse(node);
 
@@ -82,12 +212,106 @@ void TriangleExtractor::apply(osg::Transform& node)
 
 void TriangleExtractor::apply(osg::Geometry& geom)
 {
-  if (m_matrix_stack.size())
-    m_tri_op.setMatrix(*(m_matrix_stack.back().get()));
-  else
-    m_tri_op.setMatrix();
+  if (m_batch_op) {
+    extractBatch(geom, getMatrix(), m_batch);
+    if (m_batch.getNumTriangles())
+      m_batch_op->batch(m_batch);
+    return;
+  }
+
+  m_tri_op->setMatrix(getMatrix());
+  geom.accept(*m_tri_op);
+}
 
-  geom.accept(m_tri_op);
+
+void TriangleExtractor::extractBatch(const osg::Geometry& geom, const osg::Matrix& matrix, TriangleBatch& batch)
+{
+  batch.m_geometry = &geom;
+  batch.m_indices.clear();
+  batch.m_copied_vertices.clear();
+  batch.m_matrix = matrix;
+
+  const osg::Vec3Array *vertices = dynamic_cast<const osg::Vec3Array *>(geom.getVertexArray());
+  if (vertices && !vertices->empty() && !geom.getVertexIndices()) {
+    batch.m_vertices = &vertices->front();
+    batch.m_num_vertices = vertices->size();
+
+    osg::TriangleIndexFunctor<CollectIndices> collect;
+    collect.m_vertices = batch.m_vertices;
+    collect.m_indices = &batch.m_indices;
+    geom.accept(collect);
+  }
+  else {
+    osg::TriangleFunctor<CopyTriangles> copy;
+    copy.m_vertices = &batch.m_copied_vertices;
+    copy.m_indices = &batch.m_indices;
+    geom.accept(copy);
+
+    batch.m_vertices = batch.m_copied_vertices.empty() ? 0L : &batch.m_copied_vertices.front();
+    batch.m_num_vertices = batch.m_copied_vertices.size();
+  }
+}
+
+
+ParallelTriangleExtractor::ParallelTriangleExtractor(unsigned int num_threads) : m_num_threads(num_threads)
+{
+}
+
+
+void ParallelTriangleExtractor::apply(osg::Geometry& geom)
+{
+  m_items.push_back(WorkItem(&geom, getMatrix()));
+}
+
+
+void ParallelTriangleExtractor::extract(osg::Node& node, std::vector<osg::Vec3>& vertices)
+{
+  vertices.clear();
+  m_items.clear();
+  TriangleExtractor::extract(node);
+  if (m_items.empty())
+    return;
+
+  unsigned int num_threads = m_num_threads;
+  if (num_threads == 0)
+    num_threads = OpenThreads::GetNumberOfProcessors();
+  num_threads = osg::clampBetween(num_threads, 1u, (unsigned int)m_items.size());
+
+  unsigned int next = 0;
+  OpenThreads::Mutex mutex;
+  std::vector<ExtractWorker *> workers(num_threads);
+  for(unsigned int t=0; t < num_threads; t++)
+    workers[t] = new ExtractWorker(m_items, next, mutex);
+
+  if (num_threads == 1)
+    workers[0]->run();
+  else {
+    for(unsigned int t=0; t < num_threads; t++)
+      workers[t]->start();
+    for(unsigned int t=0; t < num_threads; t++)
+      workers[t]->join();
+  }
+
+  // Merge the buffers of the threads in the order the geometries were found
+  std::vector<unsigned int> offsets(m_items.size()+1, 0);
+  for(unsigned int t=0; t < num_threads; t++) {
+    for(unsigned int c=0; c < workers[t]->m_chunks.size(); c++)
+      offsets[workers[t]->m_chunks[c].item+1] = workers[t]->m_chunks[c].count;
+  }
+  for(unsigned int i=0; i < m_items.size(); i++)
+    offsets[i+1] += offsets[i];
+
+  vertices.resize(offsets.back());
+  for(unsigned int t=0; t < num_threads; t++) {
+    const ExtractWorker& worker = *workers[t];
+    for(unsigned int c=0; c < worker.m_chunks.size(); c++) {
+      const ExtractWorker::Chunk& chunk = worker.m_chunks[c];
+      std::copy(worker.m_vertices.begin()+chunk.offset, worker.m_vertices.begin()+chunk.offset+chunk.count,
+        vertices.begin()+offsets[chunk.item]);
+    }
+    delete workers[t];
+  }
+  m_items.clear();
 }
 
 
@@ -95,7 +319,7 @@ void TriangleExtractor::apply(osg::Geode& geode)
 {
   for(unsigned int i = 0; i < geode.getNumDrawables(); i++ )
   {
-    osg::Geometry* geom = dynamic_cast<osg::Geometry *>(geode.getDrawable(i));
+    osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
     if (geom) apply(*geom);
   }
 }
@@ -114,6 +338,17 @@ void TriangleExtractor::apply(osg::LOD& node)
 
 void TriangleExtractor::apply(osg::Billboard& node)
 {
+  // The rotation of a billboard follows the eye, so only the position of each drawable is known here
+  for(unsigned int i = 0; i < node.getNumDrawables(); i++ )
+  {
+    osg::Geometry* geom = node.getDrawable(i)->asGeometry();
+    if (!geom) 
+      continue;
+
+    pushMatrix(osg::Matrix::translate(node.getPosition(i)));
+    apply(*geom);
+    popMatrix();
+  }
 }
 /*------------------------------------------
 
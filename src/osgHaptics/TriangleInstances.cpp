@@ -0,0 +1,167 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+
+#include <osgHaptics/TriangleInstances.h>
+#include <osgHaptics/TriangleExtractor.h>
+#include <osg/Math>
+
+using namespace osgHaptics;
+
+namespace {
+
+  /// Adds an instance for each geometry found in the traversal
+  class CollectInstances : public TriangleExtractor {
+  public:
+    CollectInstances(TriangleInstances& instances) : m_instances(&instances) {}
+
+  protected:
+    virtual void apply(osg::Geometry& geom) { m_instances->addInstance(geom, getMatrix()); }
+
+    using TriangleExtractor::apply;
+
+  private:
+    TriangleInstances *m_instances;
+  };
+}
+
+
+TriangleInstances::TriangleInstances()
+{
+}
+
+
+void TriangleInstances::extract(osg::Node& node)
+{
+  clear();
+  CollectInstances collect(*this);
+  collect.extract(node);
+}
+
+
+void TriangleInstances::clear()
+{
+  m_triangle_sets.clear();
+  m_instances.clear();
+  m_set_indices.clear();
+  m_hierarchy = 0L;
+}
+
+
+void TriangleInstances::addInstance(const osg::Geometry& geometry, const osg::Matrix& matrix)
+{
+  std::map<const osg::Geometry *, unsigned int>::iterator it = m_set_indices.find(&geometry);
+  if (it == m_set_indices.end()) {
+    it = m_set_indices.insert(std::make_pair(&geometry, (unsigned int)m_triangle_sets.size())).first;
+    m_triangle_sets.push_back(TriangleSet::get(geometry));
+  }
+
+  const TriangleSet *triangles = m_triangle_sets[it->second].get();
+  if (!triangles->getNumTriangles())
+    return;
+
+  Instance instance;
+  instance.triangle_set = it->second;
+  instance.matrix = matrix;
+  instance.inverse = osg::Matrix::inverse(matrix);
+
+  const std::vector<osg::Vec3>& vertices = triangles->getVertices();
+  for(unsigned int i=0; i < vertices.size(); i++)
+    instance.bound.expandBy(matrix.preMult(vertices[i]));
+
+  m_instances.push_back(instance);
+  m_hierarchy = 0L;
+}
+
+
+unsigned int TriangleInstances::getNumTriangles() const
+{
+  unsigned int num_triangles = 0;
+  for(unsigned int i=0; i < m_instances.size(); i++)
+    num_triangles += m_triangle_sets[m_instances[i].triangle_set]->getNumTriangles();
+  return num_triangles;
+}
+
+
+void TriangleInstances::getTriangle(const TriangleRef& ref, osg::Vec3& v1, osg::Vec3& v2, osg::Vec3& v3) const
+{
+  const Instance& instance = m_instances[ref.instance];
+  const osg::Vec3 *v = &m_triangle_sets[instance.triangle_set]->getVertices()[3*ref.triangle];
+  v1 = instance.matrix.preMult(v[0]);
+  v2 = instance.matrix.preMult(v[1]);
+  v3 = instance.matrix.preMult(v[2]);
+}
+
+
+void TriangleInstances::getTriangleBounds(std::vector<osg::BoundingBox>& bounds, std::vector<TriangleRef>& refs) const
+{
+  unsigned int num_triangles = getNumTriangles();
+  bounds.resize(num_triangles);
+  refs.resize(num_triangles);
+
+  unsigned int n = 0;
+  for(unsigned int i=0; i < m_instances.size(); i++) {
+    const Instance& instance = m_instances[i];
+    const std::vector<osg::Vec3>& vertices = m_triangle_sets[instance.triangle_set]->getVertices();
+
+    for(unsigned int t=0; t < vertices.size()/3; t++, n++) {
+      osg::BoundingBox& bound = bounds[n];
+      bound.init();
+      bound.expandBy(instance.matrix.preMult(vertices[3*t]));
+      bound.expandBy(instance.matrix.preMult(vertices[3*t+1]));
+      bound.expandBy(instance.matrix.preMult(vertices[3*t+2]));
+      refs[n] = TriangleRef(i, t);
+    }
+  }
+}
+
+
+void TriangleInstances::query(const osg::Vec3& center, float radius, std::vector<TriangleRef>& result)
+{
+  result.clear();
+  if (m_instances.empty())
+    return;
+
+  if (!m_hierarchy.valid()) {
+    std::vector<osg::BoundingBox> bounds(m_instances.size());
+    std::vector<unsigned int> indices(m_instances.size());
+    for(unsigned int i=0; i < m_instances.size(); i++) {
+      bounds[i] = m_instances[i].bound;
+      indices[i] = i;
+    }
+    m_hierarchy = new InstanceHierarchy;
+    m_hierarchy->build(bounds, indices);
+  }
+
+  m_hierarchy->query(center, radius, m_instance_result);
+  for(unsigned int i=0; i < m_instance_result.size(); i++) {
+    unsigned int index = m_instance_result[i];
+    const Instance& instance = m_instances[index];
+
+    // Query the shared triangles in the local coordinates of the instance
+    float local_radius = radius * getMaxStretch(instance.inverse);
+    m_triangle_sets[instance.triangle_set]->getHierarchy()->query(instance.inverse.preMult(center), local_radius, 
+      m_triangle_result);
+
+    for(unsigned int t=0; t < m_triangle_result.size(); t++)
+      result.push_back(TriangleRef(index, m_triangle_result[t]));
+  }
+}
@@ -0,0 +1,217 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/TriangleSet.h>
+#include <osgHaptics/MeshDecimator.h>
+#include <osg/TriangleFunctor>
+#include <osg/Geometry>
+#include <osg/observer_ptr>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <map>
+
+using namespace osgHaptics;
+
+namespace {
+
+  /// Collects the non degenerate triangles of a drawable
+  struct CollectTriangles {
+    CollectTriangles() : m_vertices(0L) {}
+
+    void operator () (const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3, bool)
+    {
+      if (v1==v2 || v2==v3 || v1==v3) 
+        return;
+
+      m_vertices->push_back(v1);
+      m_vertices->push_back(v2);
+      m_vertices->push_back(v3);
+    }
+
+    std::vector<osg::Vec3> *m_vertices;
+  };
+
+  typedef std::vector< std::pair<const void *, unsigned int> > SourceVersion;
+
+  /// Return the array of drawable the triangles are extracted from and its modified count: 0 is the vertex array, i+1 primitive set i
+  bool getSource(const osg::Geometry *geometry, unsigned int i, SourceVersion::value_type& source)
+  {
+    if (!i) {
+      const osg::Array *array = geometry->getVertexArray();
+      source.first = array;
+      source.second = array ? array->getModifiedCount() : 0;
+      return true;
+    }
+
+    if (i > geometry->getNumPrimitiveSets())
+      return false;
+
+    const osg::PrimitiveSet *primitives = geometry->getPrimitiveSet(i-1);
+    source.first = primitives;
+    source.second = primitives->getModifiedCount();
+    return true;
+  }
+
+  /// Record the vertex array and primitive sets of drawable with their modified counts
+  void getSourceVersion(const osg::Drawable& drawable, SourceVersion& version)
+  {
+    version.clear();
+    const osg::Geometry *geometry = dynamic_cast<const osg::Geometry *>(&drawable);
+    if (!geometry)
+      return;
+
+    SourceVersion::value_type source;
+    for(unsigned int i=0; getSource(geometry, i, source); i++)
+      version.push_back(source);
+  }
+
+  /// Return true if the arrays of drawable are the ones in version, with the same modified counts. Does not allocate.
+  bool isSourceVersion(const osg::Drawable& drawable, const SourceVersion& version)
+  {
+    const osg::Geometry *geometry = dynamic_cast<const osg::Geometry *>(&drawable);
+    if (!geometry)
+      return version.empty();
+
+    if (version.size() != geometry->getNumPrimitiveSets()+1)
+      return false;
+
+    SourceVersion::value_type source;
+    for(unsigned int i=0; i < version.size(); i++) {
+      getSource(geometry, i, source);
+      if (source != version[i])
+        return false;
+    }
+    return true;
+  }
+
+  struct RegistryEntry {
+    osg::observer_ptr<osg::Drawable> drawable;
+    osg::ref_ptr<TriangleSet> triangles;
+  };
+
+  typedef std::map<const osg::Drawable *, RegistryEntry> Registry;
+
+  OpenThreads::Mutex s_registry_mutex;
+  Registry s_registry;
+
+  /// Size of the registry when entries of deleted drawables were last removed
+  unsigned int s_registry_purged_size = 0;
+}
+
+
+TriangleSet::TriangleSet(const osg::Drawable& drawable)
+{
+  getSourceVersion(drawable, m_source_version);
+
+  osg::TriangleFunctor<CollectTriangles> collect;
+  collect.m_vertices = &m_vertices;
+  drawable.accept(collect);
+}
+
+
+bool TriangleSet::isModified(const osg::Drawable& drawable) const
+{
+  return !isSourceVersion(drawable, m_source_version);
+}
+
+
+const TriangleSet::Hierarchy *TriangleSet::getHierarchy() const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_hierarchy_mutex);
+  if (m_hierarchy.valid())
+    return m_hierarchy.get();
+
+  unsigned int num_triangles = getNumTriangles();
+  std::vector<osg::BoundingBox> bounds(num_triangles);
+  std::vector<unsigned int> indices(num_triangles);
+  for(unsigned int i=0; i < num_triangles; i++) {
+    bounds[i].expandBy(m_vertices[3*i]);
+    bounds[i].expandBy(m_vertices[3*i+1]);
+    bounds[i].expandBy(m_vertices[3*i+2]);
+    indices[i] = i;
+  }
+
+  m_hierarchy = new Hierarchy;
+  m_hierarchy->build(bounds, indices);
+  return m_hierarchy.get();
+}
+
+
+void TriangleSet::buildLODs(unsigned int num_levels, float reduction)
+{
+  m_lods.clear();
+
+  MeshDecimator decimator;
+  std::vector<osg::Vec3> simplified;
+  for(unsigned int level=1; level < num_levels; level++) {
+    const std::vector<osg::Vec3>& previous = getLODVertices(level-1);
+    unsigned int num_triangles = previous.size()/3;
+    unsigned int target = (unsigned int)(num_triangles*reduction);
+    if (target < 4)
+      break;
+
+    // Stop when the surface does not allow more collapses
+    if (decimator.decimate(previous, target, simplified) > num_triangles*9/10)
+      break;
+
+    m_lods.push_back(std::vector<osg::Vec3>());
+    m_lods.back().swap(simplified);
+  }
+}
+
+
+TriangleSet *TriangleSet::find(const osg::Drawable& drawable)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_registry_mutex);
+
+  Registry::iterator it = s_registry.find(&drawable);
+  if (it != s_registry.end() && it->second.drawable.get() == &drawable && !it->second.triangles->isModified(drawable))
+    return it->second.triangles.get();
+  return 0L;
+}
+
+
+TriangleSet *TriangleSet::get(const osg::Drawable& drawable)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_registry_mutex);
+
+  Registry::iterator it = s_registry.find(&drawable);
+
+  // A deleted drawable can leave its address to a new one
+  if (it != s_registry.end() && it->second.drawable.get() == &drawable && !it->second.triangles->isModified(drawable))
+    return it->second.triangles.get();
+
+  if (it == s_registry.end() && s_registry.size() >= 2*s_registry_purged_size+16) {
+    // Drop the triangles of deleted drawables now and then
+    for(Registry::iterator rit = s_registry.begin(); rit != s_registry.end(); ) {
+      if (!rit->second.drawable.valid())
+        s_registry.erase(rit++);
+      else
+        ++rit;
+    }
+    s_registry_purged_size = s_registry.size();
+  }
+
+  RegistryEntry& entry = s_registry[&drawable];
+  entry.drawable = const_cast<osg::Drawable *>(&drawable);
+  entry.triangles = new TriangleSet(drawable);
+  return entry.triangles.get();
+}
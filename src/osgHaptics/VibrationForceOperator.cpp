@@ -19,40 +19,49 @@
 */
 
 #include <osgHaptics/VibrationForceOperator.h>
+#include <osgHaptics/HapticDevice.h>
 #include <HD/hd.h>
 #include <vrutils/math.h>
 
 using namespace osgHaptics;
 
-VibrationForceOperator::VibrationForceOperator() : ForceOperator()
+VibrationForceOperator::VibrationForceOperator(HapticDevice *device) : ForceOperator(), m_max_amplitude(0)
 {
-  hdGetDoublev(HD_NOMINAL_MAX_CONTINUOUS_FORCE, &m_amplitude);
-  m_max_amplitude = m_amplitude;
-  m_amplitude *= 0.75;
-  m_direction.set(0,1,0);
+  // hdGetDoublev needs a current HD device, so only use it if there is no HapticDevice to ask
+  if (device)
+    m_max_amplitude = device->getMaxContinuousForce();
+  else if (hdGetCurrentDevice() != HD_INVALID_HANDLE)
+    hdGetDoublev(HD_NOMINAL_MAX_CONTINUOUS_FORCE, &m_max_amplitude);
+
+  m_parameters.amplitude = m_max_amplitude*0.75;
+  m_parameter_buffer.write(m_parameters);
 }
 
-void VibrationForceOperator::calculateForce(const osg::Vec3d& in, osg::Vec3d& out, double time)
+void VibrationForceOperator::calculateForce(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out)
 {
-  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  out = m_direction*sin(2*osg::PI*time*m_frequency)*m_amplitude;
+  // Get the latest parameters published by the application, never blocks
+  const Parameters& p = m_parameter_buffer.read();
+  out = p.direction*sin(2*osg::PI*frame.time*p.frequency)*p.amplitude;
 }
 
 void VibrationForceOperator::setDirection(osg::Vec3d& direction)
 {
   direction.normalize();
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m_direction = direction;
+  m_parameters.direction = direction;
+  m_parameter_buffer.write(m_parameters);
 }
 
 void VibrationForceOperator::setAmplitude(double amplitude)
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
-  m_amplitude = vrutils::min(amplitude, m_max_amplitude);
+  m_parameters.amplitude = m_max_amplitude > 0 ? vrutils::min(amplitude, m_max_amplitude) : amplitude;
+  m_parameter_buffer.write(m_parameters);
 }
 
 void VibrationForceOperator::setFrequency(float f) 
 { 
   OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex); 
-  m_frequency = f; 
+  m_parameters.frequency = f; 
+  m_parameter_buffer.write(m_parameters);
 }
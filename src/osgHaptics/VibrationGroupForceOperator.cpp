@@ -0,0 +1,188 @@
+/* -*-c++-*- $Id: Version,v 1.2 2004/04/20 12:26:04 andersb Exp $ */
+/**
+* OsgHaptics - OpenSceneGraph Haptic Library
+* Copyright (C) 2006 VRlab, Ume University
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+*/
+
+
+#include <osgHaptics/VibrationGroupForceOperator.h>
+#include <osgHaptics/HapticDevice.h>
+#include <HD/hd.h>
+#include <vrutils/math.h>
+#include <math.h>
+
+using namespace osgHaptics;
+
+VibrationGroupForceOperator::VibrationGroupForceOperator(HapticDevice *device) : ForceOperator(), m_max_amplitude(0)
+{
+  // hdGetDoublev needs a current HD device, so only use it if there is no HapticDevice to ask
+  if (device)
+    m_max_amplitude = device->getMaxContinuousForce();
+  else if (hdGetCurrentDevice() != HD_INVALID_HANDLE)
+    hdGetDoublev(HD_NOMINAL_MAX_CONTINUOUS_FORCE, &m_max_amplitude);
+}
+
+void VibrationGroupForceOperator::calculateForce(const ServoFrame& frame, const osg::Vec3d& in, osg::Vec3d& out)
+{
+  // Get the latest vibrations published by the application, never blocks
+  const Parameters& p = m_parameter_buffer.read();
+
+  unsigned int n = p.omega.size();
+  if (!n) {
+    out.set(0,0,0);
+    return;
+  }
+
+  const double t = frame.time;
+  const double *omega = &p.omega[0];
+  double *s = &p.sine[0];
+  for(unsigned int i=0; i < n; i++)
+    s[i] = sin(omega[i]*t);
+
+  const double *x = &p.x[0], *y = &p.y[0], *z = &p.z[0];
+  double fx=0, fy=0, fz=0;
+  for(unsigned int i=0; i < n; i++) {
+    fx += x[i]*s[i];
+    fy += y[i]*s[i];
+    fz += z[i]*s[i];
+  }
+
+  out.set(fx, fy, fz);
+}
+
+void VibrationGroupForceOperator::publish()
+{
+  m_parameters.x.clear();
+  m_parameters.y.clear();
+  m_parameters.z.clear();
+  m_parameters.omega.clear();
+
+  std::vector<Vibration>::const_iterator it = m_vibrations.begin();
+  for(; it != m_vibrations.end(); it++) {
+    if (!it->enabled)
+      continue;
+
+    osg::Vec3d d = it->direction*it->amplitude;
+    m_parameters.x.push_back(d.x());
+    m_parameters.y.push_back(d.y());
+    m_parameters.z.push_back(d.z());
+    m_parameters.omega.push_back(2*osg::PI*it->frequency);
+  }
+  m_parameters.sine.resize(m_parameters.omega.size());
+
+  m_parameter_buffer.write(m_parameters);
+}
+
+unsigned int VibrationGroupForceOperator::addVibration(const osg::Vec3d& direction, double frequency, double amplitude)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  Vibration v;
+  v.direction = direction;
+  v.direction.normalize();
+  v.frequency = frequency;
+  v.amplitude = m_max_amplitude > 0 ? vrutils::min(amplitude, m_max_amplitude) : amplitude;
+  v.enabled = true;
+  m_vibrations.push_back(v);
+  publish();
+
+  return m_vibrations.size()-1;
+}
+
+void VibrationGroupForceOperator::removeAllVibrations()
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  m_vibrations.clear();
+  publish();
+}
+
+unsigned int VibrationGroupForceOperator::getNumVibrations() const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  unsigned int n = m_vibrations.size();
+  return n;
+}
+
+void VibrationGroupForceOperator::setDirection(unsigned int i, const osg::Vec3d& direction)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_vibrations.size())
+    return;
+
+  m_vibrations[i].direction = direction;
+  m_vibrations[i].direction.normalize();
+  publish();
+}
+
+osg::Vec3d VibrationGroupForceOperator::getDirection(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  osg::Vec3d d;
+  if (i < m_vibrations.size())
+    d = m_vibrations[i].direction;
+  return d;
+}
+
+void VibrationGroupForceOperator::setFrequency(unsigned int i, double frequency)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_vibrations.size())
+    return;
+
+  m_vibrations[i].frequency = frequency;
+  publish();
+}
+
+double VibrationGroupForceOperator::getFrequency(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  double f = i < m_vibrations.size() ? m_vibrations[i].frequency : 0;
+  return f;
+}
+
+void VibrationGroupForceOperator::setAmplitude(unsigned int i, double amplitude)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_vibrations.size())
+    return;
+
+  m_vibrations[i].amplitude = m_max_amplitude > 0 ? vrutils::min(amplitude, m_max_amplitude) : amplitude;
+  publish();
+}
+
+double VibrationGroupForceOperator::getAmplitude(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  double a = i < m_vibrations.size() ? m_vibrations[i].amplitude : 0;
+  return a;
+}
+
+void VibrationGroupForceOperator::setVibrationEnable(unsigned int i, bool flag)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  if (i >= m_vibrations.size())
+    return;
+
+  m_vibrations[i].enabled = flag;
+  publish();
+}
+
+bool VibrationGroupForceOperator::getVibrationEnable(unsigned int i) const
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> sl(m_mutex);
+  bool f = i < m_vibrations.size() && m_vibrations[i].enabled;
+  return f;
+}
@@ -56,6 +56,9 @@ void osgHaptics::prepareHapticCamera(osg::Camera *camera, HapticDevice *device,
 	camera->setPreDrawCallback(new HapticDevicePreRenderCallback(device));
 	camera->setPostDrawCallback(new HapticDevicePostRenderCallback(device));
 
+	// Depth buffer shapes are then read back only around the proxy
+	device->setEnableAdaptiveViewport(true);
+
 	if (0 && scene) {
 		osg::BoundingSphere bs = scene->getBound();
 		osg::Vec3 position = bs._center+osg::Vec3( 0.0,-3.5f * bs._radius,0.0f);